@@ -0,0 +1,112 @@
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "../src/access_log.h"
+#include "../src/http_common.h"
+#include "../src/third/json.hpp"
+
+using namespace std;
+using namespace http::access_log;
+using http::common::HttpException;
+using Json = nlohmann::json;
+
+/*
+ * 把二进制访问日志转成文本
+ *
+ * usage: access_log_decode <file> [text|csv|json]
+ * 每条记录输出一行，json 为 JSON lines
+ */
+
+// 2017-11-12T08:00:00.000000Z
+static string format_time(uint64_t timestamp_us) {
+    time_t seconds = timestamp_us / 1000000;
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    char buffer[64];
+    size_t size = strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(buffer + size, sizeof(buffer) - size, ".%06uZ", static_cast<unsigned>(timestamp_us % 1000000));
+    return buffer;
+}
+
+static string csv_field(const string& value) {
+    if (value.find_first_of(",\"\r\n") == string::npos) {
+        return value;
+    }
+    string quoted = "\"";
+    for (char c : value) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    return quoted + "\"";
+}
+
+static void print_text(const AccessEntry& e) {
+    cout << format_time(e.timestamp_us) << " " << e.peer << ":" << e.peer_port
+         << " " << method_name(e.method) << " " << e.path << " " << e.status
+         << " in=" << e.bytes_in << " out=" << e.bytes_out
+         << " " << e.latency_us << "us\n";
+}
+
+static void print_csv(const AccessEntry& e) {
+    cout << format_time(e.timestamp_us) << "," << method_name(e.method) << "," << csv_field(e.path)
+         << "," << e.status << "," << e.bytes_in << "," << e.bytes_out << "," << e.latency_us
+         << "," << e.peer << "," << e.peer_port << "\n";
+}
+
+static void print_json(const AccessEntry& e) {
+    Json line;
+    line["time"] = format_time(e.timestamp_us);
+    line["method"] = method_name(e.method);
+    line["path"] = e.path;
+    line["status"] = e.status;
+    line["bytes_in"] = e.bytes_in;
+    line["bytes_out"] = e.bytes_out;
+    line["latency_us"] = e.latency_us;
+    line["peer"] = e.peer;
+    line["peer_port"] = e.peer_port;
+    // path 是请求中的原始字节，不一定是合法的 UTF-8
+    cout << line.dump(-1, ' ', false, Json::error_handler_t::replace) << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " <file> [text|csv|json]" << endl;
+        return 1;
+    }
+    string format = argc > 2 ? argv[2] : "text";
+    if (format != "text" && format != "csv" && format != "json") {
+        cerr << "unknown format: " << format << endl;
+        return 1;
+    }
+
+    ifstream in(argv[1], ios::binary);
+    if (!in.is_open()) {
+        cerr << "open " << argv[1] << " fail!" << endl;
+        return 1;
+    }
+
+    if (format == "csv") {
+        cout << "time,method,path,status,bytes_in,bytes_out,latency_us,peer,peer_port\n";
+    }
+    try {
+        AccessLogReader reader(in);
+        AccessEntry entry;
+        while (reader.next(entry)) {
+            if (format == "text") {
+                print_text(entry);
+            } else if (format == "csv") {
+                print_csv(entry);
+            } else {
+                print_json(entry);
+            }
+        }
+    } catch (const HttpException& e) {
+        cout.flush();
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "../src/chunked_decoder.h"
+
+using namespace std;
+using http::chunked::ChunkedDecoder;
+
+/*
+ * chunked 请求体解码吞吐量：大量小 chunk 经 ChunkedDecoder 交给 BodySink
+ * 与 HttpServer::body_sink 的默认实现一样追加到 string
+ *
+ * usage: chunked_bench [body_mb] [read_size]
+ * read_size 模拟每次 async_read_some 读到的字节数
+ */
+
+static string encode(const string& body, size_t chunk_size) {
+    string encoded;
+    encoded.reserve(body.size() * 2);
+    char size_line[32];
+    for (size_t pos = 0; pos < body.size(); pos += chunk_size) {
+        size_t size = min(chunk_size, body.size() - pos);
+        snprintf(size_line, sizeof(size_line), "%zx\r\n", size);
+        encoded += size_line;
+        encoded.append(body, pos, size);
+        encoded += "\r\n";
+    }
+    encoded += "0\r\n\r\n";
+    return encoded;
+}
+
+int main(int argc, char* argv[]) {
+    size_t body_mb = argc > 1 ? stoul(argv[1]) : 64;
+    size_t read_size = argc > 2 ? stoul(argv[2]) : 64 * 1024;
+
+    string body(body_mb << 20, '\0');
+    for (size_t i = 0; i < body.size(); ++i) {
+        body[i] = static_cast<char>('a' + i % 26);
+    }
+
+    for (size_t chunk_size : {1, 16, 256, 4096, 65536}) {
+        // 1 字节的 chunk 编码后是原来的 6 倍，包体小一些
+        string source = chunk_size == 1 ? body.substr(0, body.size() / 8) : body;
+        string encoded = encode(source, chunk_size);
+
+        string decoded;
+        decoded.reserve(source.size());
+        http::common::BodySink sink = [&decoded](const char* data, size_t size) {
+            decoded.append(data, size);
+        };
+
+        ChunkedDecoder decoder;
+        auto begin = chrono::steady_clock::now();
+        for (size_t pos = 0; pos < encoded.size() && !decoder.done() && !decoder.error(); ) {
+            size_t size = min(read_size, encoded.size() - pos);
+            size_t consumed = decoder.feed(encoded.data() + pos, size, sink);
+            if (consumed == 0) {
+                break;
+            }
+            pos += consumed;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+        bool ok = decoder.done() && decoded == source;
+        cout << "chunk " << chunk_size << " bytes : "
+             << source.size() / (1 << 20) << " MB body, "
+             << encoded.size() / (1 << 20) << " MB encoded, "
+             << source.size() / seconds / (1 << 20) << " MB/s body, "
+             << encoded.size() / seconds / (1 << 20) << " MB/s wire"
+             << (ok ? "" : "  DECODE MISMATCH") << endl;
+    }
+    return 0;
+}
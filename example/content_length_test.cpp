@@ -0,0 +1,203 @@
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "../src/http_client.h"
+#include "../src/utils.h"
+
+using namespace std;
+using http::httpclient::HttpClient;
+
+/*
+ * 按 Content-Length 读取包体：长度正好、服务端提前关闭、服务端多发数据
+ * 小包体在读响应头时已经读完，大包体直接读到 Response::Data()
+ * 另外检查复用的连接在响应前被关闭时，只重发幂等的请求
+ *
+ * usage: content_length_test [port]
+ */
+
+struct Reply {
+    string data;
+    // 发完后关闭连接
+    bool close;
+    // 前 drops 次请求读完请求头后直接关闭连接，不响应
+    int drops;
+};
+
+// 按请求路径返回 REPLIES 中的响应
+static map<string, Reply> REPLIES;
+// 每个路径收到的请求数
+static map<string, int> HITS;
+static mutex HITS_MUTEX;
+
+static int hits(const string& path) {
+    lock_guard<mutex> lock(HITS_MUTEX);
+    return HITS[path];
+}
+
+class TestSession : public std::enable_shared_from_this<TestSession> {
+public:
+    explicit TestSession(boost::asio::io_context& io_context) : socket(io_context) {}
+
+    void read() {
+        auto self = shared_from_this();
+        boost::asio::async_read_until(socket, _buffer, "\r\n\r\n",
+            [self](const boost::system::error_code& ec, size_t size) {
+                if (ec) {
+                    return;
+                }
+                string request(boost::asio::buffers_begin(self->_buffer.data()),
+                               boost::asio::buffers_begin(self->_buffer.data()) + size);
+                self->_buffer.consume(size);
+                // 请求行中可能是完整的 url
+                size_t begin = request.find(' ') + 1;
+                string path = request.substr(begin, request.find(' ', begin) - begin);
+                size_t scheme = path.find("://");
+                if (scheme != string::npos) {
+                    path = path.substr(path.find('/', scheme + 3));
+                }
+
+                const Reply& reply = REPLIES.at(path);
+                int hit = 0;
+                {
+                    lock_guard<mutex> lock(HITS_MUTEX);
+                    hit = ++HITS[path];
+                }
+                if (hit <= reply.drops) {
+                    boost::system::error_code ignored;
+                    self->socket.close(ignored);
+                    return;
+                }
+                boost::asio::async_write(self->socket, boost::asio::buffer(reply.data),
+                    [self, &reply](const boost::system::error_code& ec, size_t) {
+                        if (ec) {
+                            return;
+                        }
+                        if (reply.close) {
+                            boost::system::error_code ignored;
+                            self->socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+                            self->socket.close(ignored);
+                            return;
+                        }
+                        self->read();
+                    });
+            });
+    }
+
+    boost::asio::ip::tcp::socket socket;
+
+private:
+    boost::asio::streambuf _buffer;
+};
+
+static void accept(boost::asio::io_context& io_context, boost::asio::ip::tcp::acceptor& acceptor) {
+    auto session = std::make_shared<TestSession>(io_context);
+    acceptor.async_accept(session->socket, [&io_context, &acceptor, session](const boost::system::error_code& ec) {
+        if (!ec) {
+            session->read();
+        }
+        accept(io_context, acceptor);
+    });
+}
+
+static string make_body(size_t size) {
+    string body(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        body[i] = static_cast<char>('a' + i % 26);
+    }
+    return body;
+}
+
+// 声明 length，实际发送 sent 个字节的包体，后面接 extra
+static void add_reply(const string& path, size_t length, size_t sent, const string& extra, bool close) {
+    REPLIES[path] = {"HTTP/1.1 200 OK\r\nContent-Length: " + to_string(length) + "\r\n\r\n"
+                     + make_body(sent) + extra, close, 0};
+}
+
+// 用异步接口取回出错时的部分包体
+static bool request(HttpClient& client, const string& url, string& error, Response& response,
+                    const string& method = "GET", const string& data = "") {
+    bool done = false;
+    client.async_request(url, method, nullptr, data, [&](const string& err, const Response& resp) {
+        error = err;
+        response = resp;
+        done = true;
+    }, 10000);
+    client.io_context().restart();
+    client.io_context().run();
+    return done;
+}
+
+static int g_failures = 0;
+
+static void check(const string& name, bool ok) {
+    cout << (ok ? "PASS " : "FAIL ") << name << endl;
+    if (!ok) {
+        ++g_failures;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int port = argc > 1 ? stoi(argv[1]) : 18092;
+    string host = "http://127.0.0.1:" + to_string(port);
+
+    const size_t SMALL = 100;
+    const size_t LARGE = 5 << 20;
+    add_reply("/empty", 0, 0, "", false);
+    for (size_t size : {SMALL, LARGE}) {
+        string suffix = "/" + to_string(size);
+        add_reply("/exact" + suffix, size, size, "", false);
+        add_reply("/short" + suffix, size, size / 2, "", true);
+        add_reply("/over" + suffix, size, size, "GARBAGE", false);
+    }
+    add_reply("/drop/get", 2, 2, "", false);
+    REPLIES["/drop/get"].drops = 1;
+    add_reply("/drop/post", 2, 2, "", false);
+    REPLIES["/drop/post"].drops = 1;
+
+    boost::asio::io_context server_context;
+    boost::asio::ip::tcp::acceptor acceptor(server_context,
+        boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+    accept(server_context, acceptor);
+    thread server_thread([&server_context]() { server_context.run(); });
+
+    HttpClient client;
+    string error;
+    Response response;
+
+    check("empty body", request(client, host + "/empty", error, response)
+          && error.empty() && response.Data().empty());
+
+    for (size_t size : {SMALL, LARGE}) {
+        string suffix = "/" + to_string(size);
+        string name = " " + to_string(size) + " bytes";
+        string body = make_body(size);
+
+        check("exact" + name, request(client, host + "/exact" + suffix, error, response)
+              && error.empty() && response.Data() == body);
+
+        // 提前关闭：报错，只带回收到的部分
+        check("short" + name, request(client, host + "/short" + suffix, error, response)
+              && error == "read error" && response.Data() == body.substr(0, size / 2));
+
+        // 多发的数据不属于包体，之后的请求不受影响
+        check("oversized" + name, request(client, host + "/over" + suffix, error, response)
+              && error.empty() && response.Data() == body);
+        check("after oversized" + name, request(client, host + "/exact" + suffix, error, response)
+              && error.empty() && response.Data() == body);
+    }
+
+    // 复用的连接在响应前被关闭：GET 换新连接重发，POST 可能已被处理，不重发
+    check("retry get on dropped connection", request(client, host + "/exact/100", error, response)
+          && request(client, host + "/drop/get", error, response)
+          && error.empty() && response.Data() == "ab" && hits("/drop/get") == 2);
+    check("no replay of post on dropped connection", request(client, host + "/exact/100", error, response)
+          && request(client, host + "/drop/post", error, response, "POST", "a=1")
+          && !error.empty() && hits("/drop/post") == 1);
+
+    server_context.stop();
+    server_thread.join();
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/http_client.h"
+#include "../src/utils.h"
+
+using namespace std;
+using http::httpclient::HttpClient;
+
+/*
+ * HttpClient 读取大响应的吞吐量：同一进程内的服务端返回预先生成的 content-length 或 chunked 响应，
+ * 客户端用 http_request 读到 Response::Data()
+ *
+ * usage: download_bench [body_mb] [port]
+ */
+
+// 按请求路径返回 RESPONSES 中的响应，保持连接
+static map<string, string> RESPONSES;
+
+class BenchSession : public std::enable_shared_from_this<BenchSession> {
+public:
+    explicit BenchSession(boost::asio::io_context& io_context) : socket(io_context) {}
+
+    void read() {
+        auto self = shared_from_this();
+        boost::asio::async_read_until(socket, _buffer, "\r\n\r\n",
+            [self](const boost::system::error_code& ec, size_t size) {
+                if (ec) {
+                    return;
+                }
+                string request(boost::asio::buffers_begin(self->_buffer.data()),
+                               boost::asio::buffers_begin(self->_buffer.data()) + size);
+                self->_buffer.consume(size);
+                // 请求行中可能是完整的 url
+                size_t begin = request.find(' ') + 1;
+                string path = request.substr(begin, request.find(' ', begin) - begin);
+                size_t scheme = path.find("://");
+                if (scheme != string::npos) {
+                    path = path.substr(path.find('/', scheme + 3));
+                }
+
+                auto it = RESPONSES.find(path);
+                const string& response = it != RESPONSES.end() ? it->second : RESPONSES.at("/");
+                boost::asio::async_write(self->socket, boost::asio::buffer(response),
+                    [self](const boost::system::error_code& ec, size_t) {
+                        if (!ec) {
+                            self->read();
+                        }
+                    });
+            });
+    }
+
+    boost::asio::ip::tcp::socket socket;
+
+private:
+    boost::asio::streambuf _buffer;
+};
+
+static void accept(boost::asio::io_context& io_context, boost::asio::ip::tcp::acceptor& acceptor) {
+    auto session = std::make_shared<BenchSession>(io_context);
+    acceptor.async_accept(session->socket, [&io_context, &acceptor, session](const boost::system::error_code& ec) {
+        if (!ec) {
+            session->read();
+        }
+        accept(io_context, acceptor);
+    });
+}
+
+static string chunked_response(const string& body, size_t chunk_size) {
+    string response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+    response.reserve(response.size() + body.size() + body.size() / chunk_size * 16 + 16);
+    char size_line[32];
+    for (size_t pos = 0; pos < body.size(); pos += chunk_size) {
+        size_t size = min(chunk_size, body.size() - pos);
+        snprintf(size_line, sizeof(size_line), "%zx\r\n", size);
+        response += size_line;
+        response.append(body, pos, size);
+        response += "\r\n";
+    }
+    response += "0\r\n\r\n";
+    return response;
+}
+
+static void run(HttpClient& client, const string& name, const string& url, const string& body) {
+    auto begin = chrono::steady_clock::now();
+    string error;
+    bool ok = false;
+    try {
+        Response response = client.http_request(url, "GET", nullptr, "", 60);
+        ok = response.Data() == body;
+    } catch (const http::common::HttpException& e) {
+        error = e.what();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    cout << name << " : " << seconds * 1000 << " ms, " << body.size() / seconds / (1 << 20) << " MB/s"
+         << (ok ? "" : "  BODY MISMATCH " + error) << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t body_mb = argc > 1 ? stoul(argv[1]) : 100;
+    int port = argc > 2 ? stoi(argv[2]) : 18091;
+    string host = "http://127.0.0.1:" + to_string(port);
+
+    string body(body_mb << 20, '\0');
+    for (size_t i = 0; i < body.size(); ++i) {
+        body[i] = static_cast<char>('a' + i % 26);
+    }
+
+    RESPONSES["/"] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+    RESPONSES["/length"] = "HTTP/1.1 200 OK\r\nContent-Length: " + to_string(body.size()) + "\r\n\r\n" + body;
+    vector<size_t> chunk_sizes = {1024, 16 * 1024, 1024 * 1024};
+    for (size_t chunk_size : chunk_sizes) {
+        RESPONSES["/chunked/" + to_string(chunk_size)] = chunked_response(body, chunk_size);
+    }
+
+    boost::asio::io_context server_context;
+    boost::asio::ip::tcp::acceptor acceptor(server_context,
+        boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+    accept(server_context, acceptor);
+    thread server_thread([&server_context]() { server_context.run(); });
+
+    HttpClient client;
+    run(client, "content-length", host + "/length", body);
+    for (size_t chunk_size : chunk_sizes) {
+        run(client, "chunked " + to_string(chunk_size / 1024) + " KB chunks", host + "/chunked/" + to_string(chunk_size), body);
+    }
+
+    server_context.stop();
+    server_thread.join();
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include "../src/json_extractor.h"
+
+using namespace std;
+using http::json::JsonExtractor;
+
+/*
+ * 按字段提取 vs 构建 DOM：耗时和解析过程中的峰值内存
+ *
+ * usage: json_bench [mb]
+ * 生成约 mb MB 的 json：{"meta": {...}, "items": [{...}, ...], "tail": {...}}
+ */
+
+// 统计堆内存，记录每次分配的大小
+static size_t g_current = 0;
+static size_t g_peak = 0;
+
+void* operator new(size_t size) {
+    size_t* p = static_cast<size_t*>(malloc(size + sizeof(size_t)));
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    *p = size;
+    g_current += size;
+    if (g_current > g_peak) {
+        g_peak = g_current;
+    }
+    return p + 1;
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr != nullptr) {
+        size_t* p = static_cast<size_t*>(ptr) - 1;
+        g_current -= *p;
+        free(p);
+    }
+}
+
+static string build_document(size_t target_size) {
+    string doc = "{\"meta\": {\"version\": 3, \"source\": \"bench\"}, \"items\": [";
+    for (size_t i = 0; doc.size() < target_size; ++i) {
+        if (i > 0) {
+            doc += ", ";
+        }
+        doc += "{\"id\": " + to_string(i) + ", \"name\": \"item-" + to_string(i) +
+               "\", \"price\": " + to_string(i % 1000) + ".25, \"tags\": [\"a\", \"b\", \"c\"], "
+               "\"active\": " + (i % 2 ? "true" : "false") + "}";
+    }
+    doc += "], \"tail\": {\"checksum\": \"deadbeef\", \"count\": 42}}";
+    return doc;
+}
+
+template <class F>
+static void run(const string& name, F parse) {
+    size_t base = g_current;
+    g_peak = g_current;
+    auto begin = chrono::steady_clock::now();
+    string result = parse();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+    cout << name << " : " << ms << " ms, peak " << (g_peak - base) / 1024.0 << " KB -> "
+         << result.substr(0, 60) << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t mb = argc > 1 ? stoul(argv[1]) : 10;
+    string doc = build_document(mb << 20);
+    cout << "document " << doc.size() / 1024.0 / 1024.0 << " MB" << endl;
+
+    struct Case {
+        string name;
+        vector<string> fields;
+    };
+    vector<Case> cases = {
+        {"meta.version (head)   ", {"meta.version"}},
+        {"items.5000.name (mid) ", {"items.5000.name"}},
+        {"tail.checksum (end)   ", {"tail.checksum"}},
+        {"tail (subtree, end)   ", {"tail"}},
+    };
+
+    for (auto& c : cases) {
+        run("extract " + c.name, [&]() {
+            map<string, string> ret;
+            JsonExtractor extractor(c.fields, ret);
+            extractor.extract(doc);
+            return ret.empty() ? string("(none)") : ret.begin()->second;
+        });
+        run("dom     " + c.name, [&]() {
+            Json json = Json::parse(doc);
+            string path = c.fields[0];
+            for (auto& ch : path) {
+                if (ch == '.') {
+                    ch = '/';
+                }
+            }
+            const Json& value = json.at(Json::json_pointer("/" + path));
+            return value.is_string() ? value.get<string>() : value.dump();
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/log.h"
+
+using namespace std;
+using namespace http::log;
+
+/*
+ * 日志单次调用耗时：每行打开、写入、关闭文件 vs 异步日志（msnprintf 格式化）vs LOGOUT
+ *
+ * usage: log_bench [lines_per_thread] [threads] [drop]
+ * 在当前目录写 log_bench.log
+ */
+
+static const string LEGACY_FILE = "log_bench.legacy.log";
+
+// 改为编译期检查之前的格式化
+static void legacy_msnprintf(string& buffer, string pattern) {}
+template <class T, class ...Args>
+static void legacy_msnprintf(string& buffer, string pattern, T head, Args... rest) {
+    size_t pos = pattern.find("%");
+    while (pos != string::npos && pos > 0 && pattern[pos-1] == '\\') {
+        pattern = pattern.substr(0, pos-1) + pattern.substr(pos);
+        pos = pattern.find("%", pos);
+    }
+    if (pos == string::npos) { throw; }
+
+    std::stringstream istr;
+    istr << head;
+    buffer += pattern.substr(0, pos) + istr.str();
+
+    string rest_pattern = pattern.substr(pos+1);
+    if (sizeof...(rest) == 0) {
+        pos = rest_pattern.find("%");
+        if (pos != string::npos && pos > 0 && rest_pattern[pos-1] != '\\') {
+            throw;
+        } else if (pos != string::npos) {
+            rest_pattern = rest_pattern.substr(0, pos-1) + rest_pattern.substr(pos);
+        }
+        buffer += rest_pattern;
+    }
+    legacy_msnprintf(buffer, rest_pattern, rest...);
+}
+
+// 改为异步之前的 LOGOUT 写法
+template <class ...Args>
+static void legacy_logout(LOG_LEVEL level, const string& pattern, Args... args) {
+    std::ofstream fout(LEGACY_FILE, std::ios::app);
+    time_t rawtime;
+    time(&rawtime);
+    string time_str(ctime(&rawtime));
+    time_str = time_str.substr(0, time_str.size()-1);
+    string buffer;
+    legacy_msnprintf(buffer, pattern, args...);
+    fout << LOG_LEVEL_STR[level] << ":" << time_str << " " << buffer << "\n";
+    fout.close();
+}
+
+template <class F>
+static void run(const string& name, int lines, int threads, F log_line) {
+    vector<vector<double>> latencies(threads);
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            latencies[t].reserve(lines);
+            for (int i = 0; i < lines; ++i) {
+                auto begin = chrono::steady_clock::now();
+                log_line(i);
+                latencies[t].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count());
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<double> all;
+    for (auto& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    sort(all.begin(), all.end());
+    double sum = 0;
+    for (double v : all) {
+        sum += v;
+    }
+    cout << name << " : mean " << sum / all.size() << " us"
+         << ", p50 " << all[all.size() / 2] << " us"
+         << ", p99 " << all[all.size() * 99 / 100] << " us"
+         << ", max " << all.back() << " us"
+         << ", " << all.size() / seconds << " lines/s" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    int lines = argc > 1 ? stoi(argv[1]) : 100000;
+    int threads = argc > 2 ? stoi(argv[2]) : 4;
+    bool drop = argc > 3 && string(argv[3]) == "drop";
+
+    LogOptions options;
+    options.positive_file = "log_bench.log";
+    options.negative_file = "log_bench.log.wf";
+    options.overflow = drop ? OverflowPolicy::Drop : OverflowPolicy::Block;
+    AsyncLogger::instance().configure(options);
+
+    string host = "www.example.com", url = "/index.html?from=bench";
+    // 每行打开文件太慢，行数少一些
+    run("open/write/close", min(lines, 20000), threads, [&](int) {
+        legacy_logout(INFO, "% request % ...", host, url);
+    });
+    // 异步写入，格式化仍使用 msnprintf
+    run("async+msnprintf ", lines, threads, [&](int) {
+        static thread_local string buffer;
+        buffer.clear();
+        buffer += LOG_LEVEL_STR[INFO];
+        buffer += ':';
+        append_time(buffer);
+        buffer += ' ';
+        legacy_msnprintf(buffer, "% request % ...", host, url);
+        buffer += '\n';
+        AsyncLogger::instance().append(LogTarget::Positive, buffer.data(), buffer.size());
+    });
+    run("async          ", lines, threads, [&](int) {
+        LOGOUT(INFO, "% request % ...", host, url);
+    });
+
+    AsyncLogger::instance().flush();
+    LogStats stats = AsyncLogger::instance().Stats();
+    cout << "lines " << stats.lines << ", dropped " << stats.dropped
+         << ", write(2) calls " << stats.writes << ", bytes " << stats.bytes << endl;
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "../src/multipart_parser.h"
+
+using namespace std;
+using http::multipart::MultipartForm;
+
+/*
+ * multipart/form-data 解析耗时：字段数增加时应保持线性
+ * 每个请求体包含 fields 个普通字段和一个 file_mb 的文件段，一次 feed 整个请求体，
+ * 与 Request::post_extract_multipart 相同；另外按 64KB 分段 feed 检查结果一致
+ *
+ * usage: multipart_bench [file_mb]
+ */
+
+static const string BOUNDARY = "----bench7MA4YWxkTrZu0gW";
+
+static string build_body(size_t fields, size_t file_size) {
+    string body;
+    for (size_t i = 0; i < fields; ++i) {
+        body += "--" + BOUNDARY + "\r\n";
+        body += "Content-Disposition: form-data; name=\"field" + to_string(i) + "\"\r\n\r\n";
+        body += "value" + to_string(i) + "\r\n";
+    }
+    body += "--" + BOUNDARY + "\r\n";
+    body += "Content-Disposition: form-data; name=\"upload\"; filename=\"a.bin\"\r\n";
+    body += "Content-Type: application/octet-stream\r\n\r\n";
+    size_t begin = body.size();
+    body.resize(begin + file_size);
+    for (size_t i = begin; i < body.size(); ++i) {
+        body[i] = static_cast<char>('a' + i % 26);
+    }
+    body += "\r\n--" + BOUNDARY + "--\r\n";
+    return body;
+}
+
+static bool check(const MultipartForm& form, size_t fields, size_t file_size) {
+    // 没有 upload_dir 时文件内容也保存在 fields 中
+    auto upload = form.fields().find("upload");
+    if (!form.done() || form.fields().size() != fields + 1 || form.files().size() != 1 ||
+        form.files()[0].size != file_size || upload == form.fields().end() || upload->second.size() != file_size) {
+        return false;
+    }
+    for (size_t i = 0; i < fields; ++i) {
+        auto it = form.fields().find("field" + to_string(i));
+        if (it == form.fields().end() || it->second != "value" + to_string(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    size_t file_size = (argc > 1 ? stoul(argv[1]) : 50) << 20;
+
+    for (size_t fields : {10, 100, 1000, 10000}) {
+        string body = build_body(fields, file_size);
+
+        auto begin = chrono::steady_clock::now();
+        MultipartForm whole(BOUNDARY);
+        whole.feed(body.data(), body.size());
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+        MultipartForm sliced(BOUNDARY);
+        for (size_t pos = 0; pos < body.size(); pos += 64 * 1024) {
+            sliced.feed(body.data() + pos, min<size_t>(64 * 1024, body.size() - pos));
+        }
+
+        bool ok = check(whole, fields, file_size) && check(sliced, fields, file_size);
+        cout << fields << " fields + " << (file_size >> 20) << " MB file : "
+             << seconds * 1000 << " ms, " << body.size() / seconds / (1 << 20) << " MB/s"
+             << (ok ? "" : "  PARSE MISMATCH") << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include "../src/http_client.h"
+#include "../src/utils.h"
+
+using namespace std;
+using http::httpclient::HttpClient;
+using http::httpclient::PoolOptions;
+
+/*
+ * 连接池前后的每秒请求数：同一进程内启动 keep-alive 服务端，依次发起同步请求
+ * 不复用连接时 max_idle_per_host 为 0，每个请求结束后关闭连接，下一个请求重新建立
+ *
+ * usage: pool_bench [requests] [port]
+ */
+
+// HttpServer 写完响应即关闭连接，这里用一个最小的 keep-alive 服务端
+class KeepAliveSession : public std::enable_shared_from_this<KeepAliveSession> {
+public:
+    explicit KeepAliveSession(boost::asio::io_context& io_context) : socket(io_context) {}
+
+    void read() {
+        auto self = shared_from_this();
+        boost::asio::async_read_until(socket, _buffer, "\r\n\r\n",
+            [self](const boost::system::error_code& ec, size_t size) {
+                if (ec) {
+                    return;
+                }
+                self->_buffer.consume(size);
+                boost::asio::async_write(self->socket, boost::asio::buffer(RESPONSE),
+                    [self](const boost::system::error_code& ec, size_t) {
+                        if (!ec) {
+                            self->read();
+                        }
+                    });
+            });
+    }
+
+    static const string RESPONSE;
+    boost::asio::ip::tcp::socket socket;
+
+private:
+    boost::asio::streambuf _buffer;
+};
+
+const string KeepAliveSession::RESPONSE = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+
+static void accept(boost::asio::io_context& io_context, boost::asio::ip::tcp::acceptor& acceptor) {
+    auto session = std::make_shared<KeepAliveSession>(io_context);
+    acceptor.async_accept(session->socket, [&io_context, &acceptor, session](const boost::system::error_code& ec) {
+        if (!ec) {
+            session->read();
+        }
+        accept(io_context, acceptor);
+    });
+}
+
+static void run(const string& name, const PoolOptions& options, const string& url, size_t requests) {
+    HttpClient client(options);
+    size_t failures = 0;
+    auto begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < requests; ++i) {
+        try {
+            Response response = client.http_request(url, "GET", nullptr, "");
+            if (response.Data() != "ok") {
+                ++failures;
+            }
+        } catch (const http::common::HttpException& e) {
+            ++failures;
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    cout << name << " : " << requests / seconds << " req/s, "
+         << seconds * 1e6 / requests << " us/req, " << failures << " failures" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t requests = argc > 1 ? stoul(argv[1]) : 10000;
+    int port = argc > 2 ? stoi(argv[2]) : 18090;
+    string url = "http://127.0.0.1:" + to_string(port) + "/bench";
+
+    boost::asio::io_context server_context;
+    boost::asio::ip::tcp::acceptor acceptor(server_context,
+        boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+    accept(server_context, acceptor);
+    thread server_thread([&server_context]() { server_context.run(); });
+
+    PoolOptions unpooled;
+    unpooled.max_idle_per_host = 0;
+    run("unpooled", unpooled, url, requests);
+    run("pooled  ", PoolOptions(), url, requests);
+
+    server_context.stop();
+    server_thread.join();
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <unistd.h>
+#include "../src/http_client.h"
+#include "../src/render_pool.h"
+
+using namespace std;
+using namespace http::httpclient;
+using namespace http::render;
+
+/*
+ * 渲染吞吐量对比：每次新建 QApplication vs 渲染进程池
+ *
+ * usage: render_bench [pages] [workers] [pages_per_worker] [html]
+ * 默认渲染 example/html/index.html，需要在 example 目录下运行
+ */
+int main(int argc, char* argv[]) {
+    int pages = argc > 1 ? stoi(argv[1]) : 200;
+    size_t workers = argc > 2 ? stoul(argv[2]) : 4;
+    size_t pages_per_worker = argc > 3 ? stoul(argv[3]) : 16;
+    string html = argc > 4 ? argv[4] : "html/index.html";
+
+    char cwd[4096];
+    if (getcwd(cwd, sizeof(cwd)) == nullptr) {
+        cerr << "getcwd fail!" << endl;
+        return 0;
+    }
+    string url = html[0] == '/' ? "file://" + html : string("file://") + cwd + "/" + html;
+
+    // 渲染进程池需要在启动其它线程之前创建
+    RenderOptions options;
+    options.workers = workers;
+    options.pages_per_worker = pages_per_worker;
+    shared_ptr<RenderPool> pool = make_shared<RenderPool>(options);
+
+    map<string, string> headers;
+    HttpClient client;
+
+    // 每次渲染新建 QApplication，页面数少一些
+    int single_pages = min(pages, 20);
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < single_pages; ++i) {
+        client.http_request_render(url, "GET", &headers, "", 5);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "new QApplication : " << single_pages / seconds << " pages/s" << endl;
+
+    client.setRenderPool(pool);
+    atomic<int> next(0), failed(0);
+    start = chrono::steady_clock::now();
+    vector<thread> threads;
+    // 每个页面一个线程，填满所有渲染进程
+    for (size_t i = 0; i < workers * pages_per_worker; ++i) {
+        threads.emplace_back([&]() {
+            while (next++ < pages) {
+                try {
+                    client.http_request_render(url, "GET", &headers, "", 5);
+                } catch (const exception& ex) {
+                    ++failed;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "render pool (" << workers << " workers x " << pages_per_worker << " pages) : " << pages / seconds << " pages/s"
+         << ", failed " << failed << endl;
+    RenderStats stats = pool->Stats();
+    cout << "subresources " << stats.subresources << ", from cache " << stats.cache_hits
+         << ", budget exceeded " << stats.timeouts << endl;
+
+    return 0;
+}
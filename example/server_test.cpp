@@ -67,6 +67,7 @@ int main(){
 
     int buffer_size;
     int port;
+    int admin_port = 0;
     try {
         if (g_conf.count("buffer_size") == 0) {
             cerr << "conf param buffer_size not find!" << endl;
@@ -78,12 +79,22 @@ int main(){
             return 0;
         }
         port = stoi(g_conf["port"]);
+        if (!g_conf["admin_port"].empty()) {
+            admin_port = stoi(g_conf["admin_port"]);
+        }
     } catch (exception e) {
         cerr << "stoi fail" << endl;
         return 0;
     }
 
     MyServer server(buffer_size, port);
+    server.setConfFile("webserver.conf");
+    if (admin_port > 0) {
+        server.setAdminPort(admin_port);
+    }
+    if (g_conf["access_log"] == "binary") {
+        server.setAccessLog(AccessLogFormat::Binary);
+    }
     server.run();
     
     return 0;
@@ -0,0 +1,210 @@
+#include "access_log.h"
+
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+#include <arpa/inet.h>
+#include "async_logger.h"
+#include "http_common.h"
+
+using namespace std;
+using http::common::HttpException;
+using http::log::AsyncLogger;
+using http::log::LogTarget;
+
+namespace http {
+namespace access_log {
+
+static const char* METHOD_NAMES[] = {
+    "OTHER", "GET", "POST", "HEAD", "PUT", "DELETE", "OPTIONS", "PATCH", "CONNECT", "TRACE"
+};
+
+// 每个线程记住已经写过定义的路径数，超过后清空重新写
+static const size_t MAX_KNOWN_PATHS = 1 << 16;
+// 新文件开头重复写出的路径定义的总字节数，超过后不再记录
+// 每个新文件都要写一遍，按字节而不是按个数限制
+static const size_t MAX_DICTIONARY_BYTES = 1 << 20;
+
+static mutex g_dictionary_mutex;
+static unordered_map<uint64_t, string> g_dictionary;
+static size_t g_dictionary_bytes = 0;
+
+static size_t align8(size_t size) {
+    return (size + 7) & ~size_t(7);
+}
+
+static void append_path(string& out, uint64_t id, const char* path, size_t size) {
+    PathRecord definition;
+    memset(&definition, 0, sizeof(definition));
+    definition.type = static_cast<uint8_t>(RecordType::Path);
+    definition.size = static_cast<uint16_t>(size);
+    definition.path_id = id;
+    out.append(reinterpret_cast<const char*>(&definition), sizeof(definition));
+    out.append(path, size);
+    out.append(align8(size) - size, '\0');
+}
+
+// 文件头 + 所有已知路径，文件为空时由 AsyncLogger 的后台线程写入
+static void write_preamble(string& out) {
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = static_cast<uint8_t>(RecordType::Header);
+    header.version = VERSION;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    lock_guard<mutex> lock(g_dictionary_mutex);
+    for (auto& path : g_dictionary) {
+        append_path(out, path.first, path.second.data(), path.second.size());
+    }
+}
+
+Method method_from_string(const string& method) {
+    for (size_t i = 1; i < sizeof(METHOD_NAMES) / sizeof(METHOD_NAMES[0]); ++i) {
+        if (method == METHOD_NAMES[i]) {
+            return static_cast<Method>(i);
+        }
+    }
+    return Method::Other;
+}
+
+const char* method_name(Method method) {
+    size_t index = static_cast<size_t>(method);
+    return index < sizeof(METHOD_NAMES) / sizeof(METHOD_NAMES[0]) ? METHOD_NAMES[index] : METHOD_NAMES[0];
+}
+
+uint64_t path_id(const char* path, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(path[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void write(AccessRecord& record, const string& path) {
+    static once_flag preamble_once;
+    static thread_local unordered_set<uint64_t> known_paths;
+    call_once(preamble_once, []() {
+        AsyncLogger::instance().setPreamble(LogTarget::Access, write_preamble);
+    });
+
+    size_t path_size = min(path.size(), MAX_PATH_SIZE);
+    record.type = static_cast<uint8_t>(RecordType::Access);
+    record.path_id = path_id(path.data(), path_size);
+
+    char data[sizeof(PathRecord) + MAX_PATH_SIZE + sizeof(AccessRecord)];
+    size_t size = 0;
+    if (known_paths.count(record.path_id) == 0) {
+        if (known_paths.size() >= MAX_KNOWN_PATHS) {
+            known_paths.clear();
+        }
+        // 轮转后的新文件由 write_preamble 重新写出定义
+        // 字典已满时不记住这个路径，之后每条记录都带上定义
+        bool in_dictionary = false;
+        {
+            lock_guard<mutex> lock(g_dictionary_mutex);
+            size_t bytes = sizeof(PathRecord) + align8(path_size);
+            if (g_dictionary.count(record.path_id) > 0) {
+                in_dictionary = true;
+            } else if (g_dictionary_bytes + bytes <= MAX_DICTIONARY_BYTES) {
+                g_dictionary.emplace(record.path_id, string(path.data(), path_size));
+                g_dictionary_bytes += bytes;
+                in_dictionary = true;
+            }
+        }
+        if (in_dictionary) {
+            known_paths.insert(record.path_id);
+        }
+
+        // 同一次写入中先写定义，保证在记录之前
+        PathRecord definition;
+        memset(&definition, 0, sizeof(definition));
+        definition.type = static_cast<uint8_t>(RecordType::Path);
+        definition.size = static_cast<uint16_t>(path_size);
+        definition.path_id = record.path_id;
+        memcpy(data + size, &definition, sizeof(definition));
+        size += sizeof(definition);
+        memcpy(data + size, path.data(), path_size);
+        memset(data + size + path_size, 0, align8(path_size) - path_size);
+        size += align8(path_size);
+    }
+    memcpy(data + size, &record, sizeof(record));
+    size += sizeof(record);
+
+    AsyncLogger::instance().append(LogTarget::Access, data, size);
+}
+
+AccessLogReader::AccessLogReader(istream& in) : _in(in), _started(false) {
+}
+
+bool AccessLogReader::read(void* data, size_t size) {
+    _in.read(static_cast<char*>(data), size);
+    return static_cast<size_t>(_in.gcount()) == size;
+}
+
+bool AccessLogReader::next(AccessEntry& entry) {
+    while (true) {
+        // 先读 8 字节，由 type 决定剩余的长度
+        char head[8];
+        if (!read(head, sizeof(head))) {
+            return false;
+        }
+        RecordType type = static_cast<RecordType>(head[0]);
+        if (!_started && type != RecordType::Header) {
+            throw HttpException("not an access log");
+        }
+
+        if (type == RecordType::Header) {
+            FileHeader header;
+            memcpy(&header, head, sizeof(header));
+            if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+                throw HttpException("not an access log");
+            }
+            if (header.version != VERSION) {
+                throw HttpException("unsupported access log version " + to_string(header.version));
+            }
+            _started = true;
+        } else if (type == RecordType::Path) {
+            PathRecord definition;
+            memcpy(&definition, head, sizeof(head));
+            if (!read(reinterpret_cast<char*>(&definition) + sizeof(head), sizeof(definition) - sizeof(head))) {
+                return false;
+            }
+            string path(align8(definition.size), '\0');
+            if (!read(&path[0], path.size())) {
+                return false;
+            }
+            path.resize(definition.size);
+            _paths[definition.path_id] = path;
+        } else if (type == RecordType::Access) {
+            AccessRecord record;
+            memcpy(&record, head, sizeof(head));
+            if (!read(reinterpret_cast<char*>(&record) + sizeof(head), sizeof(record) - sizeof(head))) {
+                return false;
+            }
+            auto path = _paths.find(record.path_id);
+
+            entry.timestamp_us = record.timestamp_us;
+            entry.method = record.method;
+            entry.path = path != _paths.end() ? path->second : "#" + to_string(record.path_id);
+            entry.status = record.status;
+            entry.bytes_in = record.bytes_in;
+            entry.bytes_out = record.bytes_out;
+            entry.latency_us = record.latency_us;
+            entry.peer_port = record.peer_port;
+            char peer[INET6_ADDRSTRLEN];
+            int family = record.peer_family == 6 ? AF_INET6 : AF_INET;
+            if (record.peer_family == 0 || inet_ntop(family, record.peer, peer, sizeof(peer)) == nullptr) {
+                entry.peer.clear();
+            } else {
+                entry.peer = peer;
+            }
+            return true;
+        } else {
+            throw HttpException("access log: unknown record type " + to_string(static_cast<unsigned char>(head[0])));
+        }
+    }
+}
+
+}}
@@ -0,0 +1,136 @@
+#ifndef __HTTP_ACCESS_LOG_H__
+#define __HTTP_ACCESS_LOG_H__
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <unordered_map>
+
+namespace http {
+namespace access_log {
+
+/*
+ * 二进制访问日志
+ *
+ * 由 AsyncLogger 写到 LogOptions::access_file，每个请求一条定长记录，
+ * 不做任何文本格式化；用 example/access_log_decode 转成文本、CSV、JSON
+ *
+ * 文件由以下记录组成，长度都是 8 的倍数，字节序为写入机器的字节序：
+ *   FileHeader   文件开头一条
+ *   PathRecord   路径定义，path_id 为路径的 64 位 FNV-1a 哈希，
+ *                每个线程第一次使用某个 path_id 前写一条；
+ *                轮转后的新文件开头重复写出所有已知路径
+ *   AccessRecord 每个请求一条
+ */
+
+static const char MAGIC[4] = {'H', 'A', 'L', 'G'};
+static const uint8_t VERSION = 1;
+// 路径超过这个长度时截断
+static const size_t MAX_PATH_SIZE = 1024;
+
+enum class RecordType : uint8_t {
+    Header = 1,
+    Path,
+    Access
+};
+
+enum class Method : uint8_t {
+    Other = 0,
+    Get,
+    Post,
+    Head,
+    Put,
+    Delete,
+    Options,
+    Patch,
+    Connect,
+    Trace
+};
+
+struct FileHeader {
+    uint8_t type;
+    uint8_t version;
+    uint16_t reserved;
+    char magic[4];
+};
+
+struct PathRecord {
+    uint8_t type;
+    uint8_t reserved;
+    // 路径长度，之后是路径，补齐到 8 的倍数
+    uint16_t size;
+    uint32_t reserved2;
+    uint64_t path_id;
+};
+
+struct AccessRecord {
+    uint8_t type;
+    Method method;
+    uint16_t status;
+    // 从 accept 到响应写完（微秒）
+    uint32_t latency_us;
+    // accept 的时间，unix 时间（微秒）
+    uint64_t timestamp_us;
+    uint64_t path_id;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    // ipv4 使用前 4 字节
+    uint8_t peer[16];
+    uint16_t peer_port;
+    // 4 或 6
+    uint8_t peer_family;
+    uint8_t reserved;
+    uint32_t reserved2;
+};
+
+static_assert(sizeof(FileHeader) == 8, "unexpected FileHeader layout");
+static_assert(sizeof(PathRecord) == 16, "unexpected PathRecord layout");
+static_assert(sizeof(AccessRecord) == 64, "unexpected AccessRecord layout");
+
+Method method_from_string(const std::string& method);
+const char* method_name(Method method);
+
+uint64_t path_id(const char* path, size_t size);
+
+/*
+ * 写一条访问记录，除 type、path_id 外由调用方填写
+ * 需要时在同一次写入中带上 PathRecord
+ */
+void write(AccessRecord& record, const std::string& path);
+
+// 解码后的访问记录
+struct AccessEntry {
+    uint64_t timestamp_us = 0;
+    Method method = Method::Other;
+    std::string path;
+    uint16_t status = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint32_t latency_us = 0;
+    std::string peer;
+    uint16_t peer_port = 0;
+};
+
+/*
+ * 顺序读取访问日志
+ * 文件不是访问日志或者已经损坏时抛 HttpException，末尾不完整的记录忽略
+ * 没有定义的路径输出为 "#<path_id>"
+ */
+class AccessLogReader {
+public:
+    explicit AccessLogReader(std::istream& in);
+
+    // 读到下一条访问记录返回 true，文件结束返回 false
+    bool next(AccessEntry& entry);
+
+private:
+    bool read(void* data, size_t size);
+
+    std::istream& _in;
+    bool _started;
+    std::unordered_map<uint64_t, std::string> _paths;
+};
+
+}}
+
+#endif
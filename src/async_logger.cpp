@@ -0,0 +1,460 @@
+#include "async_logger.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace http {
+namespace log {
+
+// 记录头：低 30 位为长度，最高 2 位为 LogTarget
+static const int TARGET_SHIFT = 30;
+static const uint32_t SIZE_MASK = (1u << TARGET_SHIFT) - 1;
+static const size_t HEADER_SIZE = sizeof(uint32_t);
+
+static size_t round_up_power_of_two(size_t size) {
+    size_t capacity = 64;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+LogRingBuffer::LogRingBuffer(size_t capacity)
+    : closed(false),
+      dropped(0),
+      _mask(round_up_power_of_two(capacity) - 1),
+      _head(0),
+      _tail(0) {
+    _data.reset(new char[_mask + 1]);
+}
+
+size_t LogRingBuffer::capacity() const {
+    return _mask + 1;
+}
+
+size_t LogRingBuffer::used() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+}
+
+void LogRingBuffer::copy_in(uint64_t pos, const char* data, size_t size) {
+    size_t offset = pos & _mask;
+    size_t first = min(size, capacity() - offset);
+    memcpy(_data.get() + offset, data, first);
+    memcpy(_data.get(), data + first, size - first);
+}
+
+void LogRingBuffer::copy_out(uint64_t pos, char* data, size_t size) const {
+    size_t offset = pos & _mask;
+    size_t first = min(size, capacity() - offset);
+    memcpy(data, _data.get() + offset, first);
+    memcpy(data + first, _data.get(), size - first);
+}
+
+void LogRingBuffer::append_out(uint64_t pos, size_t size, string& out) const {
+    size_t offset = pos & _mask;
+    size_t first = min(size, capacity() - offset);
+    out.append(_data.get() + offset, first);
+    out.append(_data.get(), size - first);
+}
+
+bool LogRingBuffer::push(LogTarget target, const char* data, size_t size) {
+    uint64_t head = _head.load(std::memory_order_relaxed);
+    uint64_t tail = _tail.load(std::memory_order_acquire);
+    if (capacity() - (head - tail) < HEADER_SIZE + size) {
+        return false;
+    }
+    uint32_t header = static_cast<uint32_t>(size) | (static_cast<uint32_t>(target) << TARGET_SHIFT);
+    copy_in(head, reinterpret_cast<const char*>(&header), HEADER_SIZE);
+    copy_in(head + HEADER_SIZE, data, size);
+    _head.store(head + HEADER_SIZE + size, std::memory_order_release);
+    return true;
+}
+
+size_t LogRingBuffer::drain(array<string, LOG_TARGET_COUNT>& out) {
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    uint64_t head = _head.load(std::memory_order_acquire);
+    size_t lines = 0;
+    while (tail < head) {
+        uint32_t header;
+        copy_out(tail, reinterpret_cast<char*>(&header), HEADER_SIZE);
+        size_t size = header & SIZE_MASK;
+        append_out(tail + HEADER_SIZE, size, out[header >> TARGET_SHIFT]);
+        tail += HEADER_SIZE + size;
+        ++lines;
+    }
+    _tail.store(tail, std::memory_order_release);
+    return lines;
+}
+
+static int open_log_file(const string& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "open log file fatal!" << std::endl;
+    }
+    return fd;
+}
+
+AsyncLogger& AsyncLogger::instance() {
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::AsyncLogger()
+    : _started(false),
+      _stopping(false),
+      _flush_requested(0),
+      _flush_done(0),
+      _wake_pending(false),
+      _reopen(false),
+      _suppressed(0),
+      _reported_dropped(0) {
+}
+
+AsyncLogger::~AsyncLogger() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (!_started) {
+            return;
+        }
+        _stopping = true;
+    }
+    _wakeup.notify_one();
+    // 后台线程退出前写出剩余的日志
+    _writer.join();
+    for (size_t i = 0; i < LOG_TARGET_COUNT; ++i) {
+        close_file(static_cast<LogTarget>(i));
+    }
+}
+
+void AsyncLogger::configure(const LogOptions& options) {
+    lock_guard<mutex> lock(_mutex);
+    if (!_started) {
+        _options = options;
+    }
+}
+
+void AsyncLogger::setRotation(uint64_t rotate_bytes, int rotate_seconds) {
+    lock_guard<mutex> lock(_mutex);
+    _options.rotate_bytes = rotate_bytes;
+    _options.rotate_seconds = rotate_seconds;
+}
+
+void AsyncLogger::reopen() {
+    _reopen = true;
+    wake();
+}
+
+void AsyncLogger::setPreamble(LogTarget target, function<void(string&)> preamble) {
+    lock_guard<mutex> lock(_mutex);
+    _preambles[static_cast<int>(target)] = preamble;
+}
+
+void AsyncLogger::add_suppressed() {
+    _suppressed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AsyncLogger::start_locked() {
+    _files[static_cast<int>(LogTarget::Positive)].path = _options.positive_file;
+    _files[static_cast<int>(LogTarget::Negative)].path = _options.negative_file;
+    _files[static_cast<int>(LogTarget::Access)].path = _options.access_file;
+    open_file(LogTarget::Positive);
+    open_file(LogTarget::Negative);
+    _started = true;
+    _writer = thread(&AsyncLogger::run, this);
+}
+
+void AsyncLogger::open_file(LogTarget target) {
+    LogFile& file = _files[static_cast<int>(target)];
+    file.fd = open_log_file(file.path);
+    struct stat st;
+    file.size = (file.fd >= 0 && fstat(file.fd, &st) == 0) ? st.st_size : 0;
+    // 追加到已有文件时不知道 preamble 的大小，全部按记录计算
+    file.preamble = 0;
+    file.opened = time(nullptr);
+}
+
+void AsyncLogger::close_file(LogTarget target) {
+    LogFile& file = _files[static_cast<int>(target)];
+    if (file.fd >= 0) {
+        close(file.fd);
+        file.fd = -1;
+    }
+}
+
+void AsyncLogger::rotate_file(LogTarget target) {
+    LogFile& file = _files[static_cast<int>(target)];
+    close_file(target);
+
+    // webserver.log -> webserver.log.20171112-080000，同一秒内再次轮转时加序号
+    time_t now = time(nullptr);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char suffix[32];
+    strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &tm);
+    string rotated = file.path + suffix;
+    struct stat st;
+    for (int i = 1; ::stat(rotated.c_str(), &st) == 0; ++i) {
+        rotated = file.path + suffix + "." + to_string(i);
+    }
+    if (::rename(file.path.c_str(), rotated.c_str()) != 0) {
+        std::cerr << "rotate log file " << file.path << " fail: " << strerror(errno) << std::endl;
+    }
+    open_file(target);
+}
+
+LogRingBuffer* AsyncLogger::thread_buffer() {
+    // 线程退出时标记，由后台线程取空后释放
+    struct ThreadBuffer {
+        shared_ptr<LogRingBuffer> buffer;
+        ~ThreadBuffer() {
+            if (buffer != nullptr) {
+                buffer->closed = true;
+            }
+        }
+    };
+    static thread_local ThreadBuffer local;
+
+    if (local.buffer == nullptr) {
+        lock_guard<mutex> lock(_mutex);
+        local.buffer = make_shared<LogRingBuffer>(_options.buffer_size);
+        _buffers.push_back(local.buffer);
+        if (!_started) {
+            start_locked();
+        }
+    }
+    return local.buffer.get();
+}
+
+void AsyncLogger::wake() {
+    if (!_wake_pending.exchange(true)) {
+        // 加锁保证后台线程检查条件和开始等待之间不会漏掉通知
+        { lock_guard<mutex> lock(_mutex); }
+        _wakeup.notify_one();
+    }
+}
+
+void AsyncLogger::append(LogTarget target, const char* data, size_t size) {
+    LogRingBuffer* buffer = thread_buffer();
+
+    string truncated;
+    size_t limit = buffer->capacity() / 4;
+    if (size > limit && target == LogTarget::Access) {
+        // 二进制记录截断后无法解析
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    } else if (size > limit) {
+        truncated.assign(data, limit - 1);
+        truncated += '\n';
+        data = truncated.data();
+        size = truncated.size();
+    }
+
+    if (buffer->push(target, data, size)) {
+        if (buffer->used() > buffer->capacity() / 2) {
+            wake();
+        }
+        return;
+    }
+    if (_options.overflow == OverflowPolicy::Drop) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        wake();
+        return;
+    }
+    while (!buffer->push(target, data, size)) {
+        wake();
+        this_thread::sleep_for(chrono::microseconds(50));
+    }
+}
+
+void AsyncLogger::flush() {
+    unique_lock<mutex> lock(_mutex);
+    if (!_started) {
+        return;
+    }
+    uint64_t id = ++_flush_requested;
+    _wakeup.notify_one();
+    _flushed.wait(lock, [this, id]() { return _flush_done >= id; });
+}
+
+LogStats AsyncLogger::Stats() const {
+    lock_guard<mutex> lock(_mutex);
+    LogStats stats = _stats;
+    stats.suppressed = _suppressed.load(std::memory_order_relaxed);
+    return stats;
+}
+
+static bool write_all(int fd, const string& data, uint64_t& writes) {
+    const char* p = data.data();
+    size_t size = data.size();
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        ++writes;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+void AsyncLogger::run() {
+    unique_lock<mutex> lock(_mutex);
+    while (true) {
+        _wakeup.wait_for(lock, chrono::milliseconds(_options.flush_interval_ms), [this]() {
+            return _stopping || _flush_requested != _flush_done || _wake_pending.load();
+        });
+        _wake_pending = false;
+        uint64_t requested = _flush_requested;
+        bool stopping = _stopping;
+        lock.unlock();
+
+        write_out();
+
+        lock.lock();
+        _flush_done = requested;
+        _flushed.notify_all();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void AsyncLogger::write_out() {
+    vector<shared_ptr<LogRingBuffer>> buffers;
+    array<function<void(string&)>, LOG_TARGET_COUNT> preambles;
+    uint64_t rotate_bytes;
+    int rotate_seconds;
+    {
+        lock_guard<mutex> lock(_mutex);
+        buffers = _buffers;
+        preambles = _preambles;
+        rotate_bytes = _options.rotate_bytes;
+        rotate_seconds = _options.rotate_seconds;
+    }
+
+    if (_reopen.exchange(false)) {
+        for (size_t i = 0; i < LOG_TARGET_COUNT; ++i) {
+            LogTarget target = static_cast<LogTarget>(i);
+            if (_files[i].fd >= 0) {
+                close_file(target);
+                open_file(target);
+            }
+        }
+    }
+
+    for (auto& pending : _pending) {
+        pending.clear();
+    }
+    uint64_t lines = 0;
+    uint64_t dropped = 0;
+    vector<LogRingBuffer*> finished;
+    for (auto& buffer : buffers) {
+        // 先读 closed，之后取出的一定包含线程退出前写入的所有记录
+        bool closed = buffer->closed;
+        lines += buffer->drain(_pending);
+        dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+        if (closed) {
+            finished.push_back(buffer.get());
+        }
+    }
+
+    string& negative = _pending[static_cast<int>(LogTarget::Negative)];
+    if (dropped > 0) {
+        negative += "WARN:";
+        append_time(negative);
+        negative += " log buffer full, dropped " + to_string(dropped) + " lines\n";
+    }
+
+    uint64_t writes = 0;
+    uint64_t bytes = 0;
+    uint64_t rotations = 0;
+    time_t now = time(nullptr);
+    for (size_t i = 0; i < LOG_TARGET_COUNT; ++i) {
+        // 只在有内容要写时轮转，不产生空文件
+        if (_pending[i].empty()) {
+            continue;
+        }
+        LogTarget target = static_cast<LogTarget>(i);
+        LogFile& file = _files[i];
+        // preamble 每个文件都有，只按记录的大小轮转，否则 preamble 超过 rotate_bytes 时每次都轮转
+        if (file.fd >= 0 && file.size > file.preamble &&
+            ((rotate_bytes > 0 && file.size - file.preamble + _pending[i].size() > rotate_bytes) ||
+             (rotate_seconds > 0 && now - file.opened >= rotate_seconds))) {
+            rotate_file(target);
+            ++rotations;
+        }
+        // 访问日志没有启用时不创建文件
+        if (file.fd < 0) {
+            open_file(target);
+        }
+        if (file.fd < 0) {
+            continue;
+        }
+        if (file.size == 0 && preambles[i]) {
+            string preamble;
+            preambles[i](preamble);
+            write_all(file.fd, preamble, writes);
+            file.size += preamble.size();
+            file.preamble = preamble.size();
+            bytes += preamble.size();
+        }
+        write_all(file.fd, _pending[i], writes);
+        file.size += _pending[i].size();
+        bytes += _pending[i].size();
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    _stats.lines += lines;
+    _stats.dropped += dropped;
+    _stats.writes += writes;
+    _stats.bytes += bytes;
+    _stats.rotations += rotations;
+    for (LogRingBuffer* buffer : finished) {
+        for (auto it = _buffers.begin(); it != _buffers.end(); ++it) {
+            if (it->get() == buffer) {
+                _buffers.erase(it);
+                break;
+            }
+        }
+    }
+}
+
+const char* cached_time(size_t& size) {
+    static thread_local time_t cached_second = 0;
+    static thread_local char cached[32];
+    static thread_local size_t cached_size = 0;
+
+    time_t now = time(nullptr);
+    if (now != cached_second) {
+        cached_second = now;
+        if (ctime_r(&now, cached) != nullptr) {
+            cached_size = strlen(cached);
+            // 去掉 ctime 末尾的换行
+            if (cached_size > 0 && cached[cached_size - 1] == '\n') {
+                --cached_size;
+            }
+        }
+    }
+    size = cached_size;
+    return cached;
+}
+
+void append_time(string& out) {
+    size_t size;
+    const char* data = cached_time(size);
+    out.append(data, size);
+}
+
+}}
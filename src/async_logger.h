@@ -0,0 +1,199 @@
+#ifndef __HTTP_ASYNC_LOGGER_H__
+#define __HTTP_ASYNC_LOGGER_H__
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace http {
+namespace log {
+
+// 线程的缓冲区满时的处理
+enum class OverflowPolicy {
+    // 等待后台线程写出
+    Block,
+    // 丢弃这一行，计入 LogStats::dropped
+    Drop
+};
+
+// 日志写到的文件
+enum class LogTarget {
+    // TRACE、DEBUG、INFO
+    Positive = 0,
+    // WARN、ERROR、FATAL
+    Negative,
+    // 二进制访问日志，见 access_log.h
+    Access
+};
+
+static const size_t LOG_TARGET_COUNT = 3;
+
+struct LogOptions {
+    // 每个线程的环形缓冲区大小，向上取整到 2 的幂；单行超过 1/4 时截断
+    size_t buffer_size = 1 << 20;
+    OverflowPolicy overflow = OverflowPolicy::Block;
+    // 后台线程写文件的间隔（毫秒）
+    int flush_interval_ms = 100;
+    // TRACE、DEBUG、INFO
+    std::string positive_file = "webserver.log";
+    // WARN、ERROR、FATAL
+    std::string negative_file = "webserver.log.wf";
+    // 二进制访问日志，第一次写入时打开
+    std::string access_file = "webserver.access.bin";
+    // 文件超过这个大小时轮转，0 表示不按大小轮转
+    uint64_t rotate_bytes = 0;
+    // 文件打开超过这个时间（秒）时轮转，0 表示不按时间轮转
+    int rotate_seconds = 0;
+};
+
+struct LogStats {
+    uint64_t lines = 0;
+    uint64_t dropped = 0;
+    // write(2) 调用次数
+    uint64_t writes = 0;
+    uint64_t bytes = 0;
+    // 被 LOGOUT_EVERY_N、LOGOUT_RATE 跳过的行数
+    uint64_t suppressed = 0;
+    uint64_t rotations = 0;
+};
+
+/*
+ * 单生产者单消费者的环形缓冲区，记录为 4 字节头（目标文件 + 长度）+ 内容
+ * 生产者是所属的线程，消费者是后台写线程
+ */
+class LogRingBuffer {
+public:
+    explicit LogRingBuffer(size_t capacity);
+
+    // 空间不足时返回 false
+    bool push(LogTarget target, const char* data, size_t size);
+    // 取出所有记录，按目标文件追加到 out，返回记录数
+    size_t drain(std::array<std::string, LOG_TARGET_COUNT>& out);
+
+    size_t capacity() const;
+    size_t used() const;
+
+    // 所属线程已经退出，取空后释放
+    std::atomic<bool> closed;
+    // 生产者丢弃的行数
+    std::atomic<uint64_t> dropped;
+
+private:
+    void copy_in(uint64_t pos, const char* data, size_t size);
+    void copy_out(uint64_t pos, char* data, size_t size) const;
+    void append_out(uint64_t pos, size_t size, std::string& out) const;
+
+    std::unique_ptr<char[]> _data;
+    size_t _mask;
+    // 写位置，只由生产者修改
+    alignas(64) std::atomic<uint64_t> _head;
+    // 读位置，只由消费者修改
+    alignas(64) std::atomic<uint64_t> _tail;
+};
+
+/*
+ * 异步日志
+ *
+ * 每个线程格式化后写入自己的环形缓冲区，不加锁；
+ * 后台线程定期取出所有缓冲区的内容，每个文件一次 write(2)
+ * 轮转也由后台线程在两次写入之间完成，不会丢失或拆开记录
+ * 不能在 fork 出的子进程中使用
+ */
+class AsyncLogger {
+public:
+    static AsyncLogger& instance();
+
+    // 在第一次写日志之前调用
+    void configure(const LogOptions& options);
+
+    // 运行时修改轮转条件，含义同 LogOptions
+    void setRotation(uint64_t rotate_bytes, int rotate_seconds);
+
+    // 关闭并重新打开所有文件，用于外部的 logrotate 移走文件之后
+    void reopen();
+
+    /*
+     * 文件为空时（新建或者轮转后）先写入 preamble 生成的内容
+     * 用于二进制文件的文件头和字典，在后台线程中调用
+     */
+    void setPreamble(LogTarget target, std::function<void(std::string& out)> preamble);
+
+    // Access 的记录超过缓冲区的 1/4 时丢弃，其它截断
+    void append(LogTarget target, const char* data, size_t size);
+
+    // 等待已经写入缓冲区的日志写到文件
+    void flush();
+
+    LogStats Stats() const;
+
+    void add_suppressed();
+
+    ~AsyncLogger();
+
+private:
+    AsyncLogger();
+    AsyncLogger(const AsyncLogger&);
+    AsyncLogger& operator=(const AsyncLogger&);
+
+    struct LogFile {
+        std::string path;
+        int fd = -1;
+        uint64_t size = 0;
+        // 文件开头 preamble 的大小，不计入轮转的大小
+        uint64_t preamble = 0;
+        time_t opened = 0;
+    };
+
+    LogRingBuffer* thread_buffer();
+    void start_locked();
+    // 以下只在后台线程中调用，start_locked 除外
+    void open_file(LogTarget target);
+    void close_file(LogTarget target);
+    void rotate_file(LogTarget target);
+    void run();
+    // 取出所有缓冲区并写到文件，只在后台线程中调用
+    void write_out();
+    void wake();
+
+    LogOptions _options;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wakeup;
+    std::condition_variable _flushed;
+    std::vector<std::shared_ptr<LogRingBuffer>> _buffers;
+    std::thread _writer;
+    bool _started;
+    bool _stopping;
+    // flush 请求和完成的序号
+    uint64_t _flush_requested;
+    uint64_t _flush_done;
+    std::atomic<bool> _wake_pending;
+
+    std::array<LogFile, LOG_TARGET_COUNT> _files;
+    std::array<std::string, LOG_TARGET_COUNT> _pending;
+    std::array<std::function<void(std::string&)>, LOG_TARGET_COUNT> _preambles;
+    std::atomic<bool> _reopen;
+    std::atomic<uint64_t> _suppressed;
+    // 已经报告过的丢弃行数
+    uint64_t _reported_dropped;
+    LogStats _stats;
+};
+
+/*
+ * 当前时间，格式同 ctime，不含换行；每个线程每秒只格式化一次
+ * 返回的指针在同一线程下次调用前有效
+ */
+const char* cached_time(size_t& size);
+void append_time(std::string& out);
+
+}}
+
+#endif
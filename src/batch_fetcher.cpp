@@ -0,0 +1,142 @@
+#include "batch_fetcher.h"
+
+#include "http_client.h"
+
+using namespace std;
+using http::response::Response;
+
+namespace http {
+namespace httpclient {
+
+BatchFetcher::BatchFetcher(HttpClient& client,
+                           const vector<string>& urls,
+                           const BatchOptions& options,
+                           BatchHandler handler,
+                           function<void()> done)
+    : _client(client),
+      _strand(client._io_context.get_executor()),
+      _urls(urls),
+      _options(options),
+      _handler(handler),
+      _done(done),
+      _active(0),
+      _completed(0) {
+    if (_options.max_concurrency == 0) {
+        _options.max_concurrency = 1;
+    }
+    if (_options.max_per_host == 0) {
+        _options.max_per_host = 1;
+    }
+}
+
+void BatchFetcher::start() {
+    auto self = shared_from_this();
+    boost::asio::post(_strand, [self, this]() {
+        if (_urls.empty()) {
+            if (_done) {
+                _done();
+            }
+            return;
+        }
+
+        vector<string> order;
+        for (size_t i = 0; i < _urls.size(); ++i) {
+            string protocol, host, port, key;
+            // 无效的 url 归为一组，由请求本身报错
+            if (_client.extract_host_port(_urls[i], protocol, host, port)) {
+                key = protocol + "://" + host + ":" + port;
+            }
+            HostState& state = _hosts[key];
+            if (state.pending.empty()) {
+                order.push_back(key);
+            }
+            state.pending.push_back(i);
+        }
+
+        for (const auto& key : order) {
+            update_host(key, _hosts[key]);
+        }
+        schedule();
+    });
+}
+
+void BatchFetcher::update_host(const string& key, HostState& host) {
+    if (host.ready || host.delayed || host.pending.empty()
+        || host.active >= _options.max_per_host) {
+        return;
+    }
+
+    if (chrono::steady_clock::now() >= host.next_start) {
+        host.ready = true;
+        _ready.push_back(key);
+        return;
+    }
+
+    if (host.timer == nullptr) {
+        host.timer.reset(new boost::asio::steady_timer(_client._io_context));
+    }
+    host.delayed = true;
+    host.timer->expires_at(host.next_start);
+
+    auto self = shared_from_this();
+    host.timer->async_wait(boost::asio::bind_executor(_strand,
+        [self, this, key](const boost::system::error_code&) {
+            HostState& host = _hosts[key];
+            host.delayed = false;
+            update_host(key, host);
+            schedule();
+        }));
+}
+
+void BatchFetcher::schedule() {
+    while (_active < _options.max_concurrency && !_ready.empty()) {
+        string key = _ready.front();
+        _ready.pop_front();
+
+        HostState& host = _hosts[key];
+        host.ready = false;
+        launch(key, host);
+        // 还能继续发起请求时排到队尾
+        update_host(key, host);
+    }
+}
+
+void BatchFetcher::launch(const string& key, HostState& host) {
+    size_t index = host.pending.front();
+    host.pending.pop_front();
+    ++host.active;
+    ++_active;
+    host.next_start = chrono::steady_clock::now() + chrono::milliseconds(_options.host_delay_ms);
+
+    auto self = shared_from_this();
+    _client.async_request(_urls[index], _options.method, &_options.headers, "",
+        [self, this, index, key](const string& error, Response& response) {
+            // 回调在请求自己的 strand 上，转到调度的 strand
+            auto result = make_shared<Response>(std::move(response));
+            boost::asio::post(_strand, [self, this, index, key, error, result]() {
+                complete(index, key, error, *result);
+            });
+        },
+        _options.timeout_ms);
+}
+
+void BatchFetcher::complete(size_t index,
+                            const string& key,
+                            const string& error,
+                            Response& response) {
+    HostState& host = _hosts[key];
+    --host.active;
+    --_active;
+    ++_completed;
+
+    _handler(index, _urls[index], error, response);
+
+    update_host(key, host);
+    schedule();
+
+    if (_completed == _urls.size() && _done) {
+        _done();
+    }
+}
+
+}}
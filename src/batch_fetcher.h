@@ -0,0 +1,101 @@
+#ifndef __HTTP_BATCH_FETCHER_H__
+#define __HTTP_BATCH_FETCHER_H__
+
+#include <map>
+#include <deque>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "response.h"
+
+namespace http {
+namespace httpclient {
+
+class HttpClient;
+
+struct BatchOptions {
+    // 同时进行的请求数
+    size_t max_concurrency = 64;
+    // 每个 host 同时进行的请求数
+    size_t max_per_host = 2;
+    // 同一 host 相邻两个请求开始的最小间隔（毫秒）
+    int host_delay_ms = 0;
+    // 单个请求超时（毫秒），从请求开始执行时计算，不包括排队时间
+    int timeout_ms = 10000;
+    std::string method = "GET";
+    std::map<std::string, std::string> headers;
+};
+
+/*
+ * 批量请求回调
+ * index 为 url 在列表中的下标，error 为空表示成功
+ */
+typedef std::function<void(size_t index,
+                           const std::string& url,
+                           const std::string& error,
+                           http::response::Response& response)> BatchHandler;
+
+/*
+ * 批量抓取调度
+ *
+ * url 按 scheme://host:port 分组，各 host 轮流发起请求，
+ * 同时受全局并发数、host 并发数和 host 请求间隔限制
+ * 调度和回调都在同一个 strand 上执行
+ */
+class BatchFetcher : public std::enable_shared_from_this<BatchFetcher> {
+public:
+    BatchFetcher(HttpClient& client,
+                 const std::vector<std::string>& urls,
+                 const BatchOptions& options,
+                 BatchHandler handler,
+                 std::function<void()> done);
+
+    void start();
+
+private:
+    typedef boost::asio::strand<boost::asio::io_context::executor_type> strand_type;
+
+    struct HostState {
+        std::deque<size_t> pending;
+        size_t active = 0;
+        // 下一个请求最早的开始时间
+        std::chrono::steady_clock::time_point next_start;
+        // 已在 _ready 中
+        bool ready = false;
+        // 正在等待请求间隔
+        bool delayed = false;
+        std::unique_ptr<boost::asio::steady_timer> timer;
+    };
+
+    // host 可以发起请求时加入 _ready，需要等待请求间隔时启动定时器
+    void update_host(const std::string& key, HostState& host);
+    void schedule();
+    void launch(const std::string& key, HostState& host);
+    void complete(size_t index,
+                  const std::string& key,
+                  const std::string& error,
+                  http::response::Response& response);
+
+    HttpClient& _client;
+    strand_type _strand;
+    std::vector<std::string> _urls;
+    BatchOptions _options;
+    BatchHandler _handler;
+    std::function<void()> _done;
+
+    std::unordered_map<std::string, HostState> _hosts;
+    // 可以发起请求的 host，轮流调度
+    std::deque<std::string> _ready;
+    size_t _active;
+    size_t _completed;
+};
+
+}}
+
+#endif
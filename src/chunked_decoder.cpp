@@ -0,0 +1,158 @@
+#include "chunked_decoder.h"
+
+#include <algorithm>
+#include "utils.h"
+
+using http::utils::hex_value;
+
+namespace http {
+namespace chunked {
+
+// chunk-size 上限，防止溢出
+static const uint64_t MAX_CHUNK_SIZE = uint64_t(1) << 60;
+
+ChunkedDecoder::ChunkedDecoder() {
+    reset();
+}
+
+void ChunkedDecoder::reset() {
+    _state = SIZE;
+    _chunk_size = 0;
+    _body_size = 0;
+    _size_digits = false;
+}
+
+size_t ChunkedDecoder::feed(const char* data, size_t size, const http::common::BodySink& sink) {
+    size_t i = 0;
+    while (i < size && _state != DONE && _state != ERROR) {
+        char c = data[i];
+        switch (_state) {
+            case SIZE: {
+                int v = hex_value(c);
+                if (v >= 0) {
+                    if (_chunk_size >= MAX_CHUNK_SIZE) {
+                        _state = ERROR;
+                        break;
+                    }
+                    _chunk_size = (_chunk_size << 4) | v;
+                    _size_digits = true;
+                } else if (!_size_digits) {
+                    _state = ERROR;
+                } else if (c == ';' || c == ' ' || c == '\t') {
+                    _state = SIZE_EXT;
+                } else if (c == '\r') {
+                    _state = SIZE_LF;
+                } else if (c == '\n') {
+                    _state = _chunk_size == 0 ? TRAILER : DATA;
+                } else {
+                    _state = ERROR;
+                }
+                ++i;
+                break;
+            }
+            case SIZE_EXT:
+                if (c == '\r') {
+                    _state = SIZE_LF;
+                } else if (c == '\n') {
+                    _state = _chunk_size == 0 ? TRAILER : DATA;
+                }
+                ++i;
+                break;
+            case SIZE_LF:
+                if (c != '\n') {
+                    _state = ERROR;
+                    break;
+                }
+                _state = _chunk_size == 0 ? TRAILER : DATA;
+                ++i;
+                break;
+            case DATA: {
+                // 一次性把当前 chunk 能拿到的数据交给 sink
+                size_t n = size_t(std::min<uint64_t>(_chunk_size, size - i));
+                if (sink) {
+                    sink(data + i, n);
+                }
+                skip(n);
+                i += n;
+                break;
+            }
+            case DATA_CR:
+                if (c == '\r') {
+                    _state = DATA_LF;
+                } else if (c == '\n') {
+                    _state = SIZE;
+                } else {
+                    _state = ERROR;
+                    break;
+                }
+                ++i;
+                break;
+            case DATA_LF:
+                if (c != '\n') {
+                    _state = ERROR;
+                    break;
+                }
+                _state = SIZE;
+                ++i;
+                break;
+            case TRAILER:
+                if (c == '\r') {
+                    _state = TRAILER_LF;
+                } else if (c == '\n') {
+                    _state = DONE;
+                } else {
+                    _state = TRAILER_LINE;
+                }
+                ++i;
+                break;
+            case TRAILER_LINE:
+                if (c == '\n') {
+                    _state = TRAILER;
+                }
+                ++i;
+                break;
+            case TRAILER_LF:
+                if (c != '\n') {
+                    _state = ERROR;
+                    break;
+                }
+                _state = DONE;
+                ++i;
+                break;
+            default:
+                break;
+        }
+    }
+    return i;
+}
+
+uint64_t ChunkedDecoder::chunk_remaining() const {
+    return _state == DATA ? _chunk_size : 0;
+}
+
+void ChunkedDecoder::skip(size_t size) {
+    if (_state != DATA || size > _chunk_size) {
+        _state = ERROR;
+        return;
+    }
+    _chunk_size -= size;
+    _body_size += size;
+    if (_chunk_size == 0) {
+        _state = DATA_CR;
+        _size_digits = false;
+    }
+}
+
+bool ChunkedDecoder::done() const {
+    return _state == DONE;
+}
+
+bool ChunkedDecoder::error() const {
+    return _state == ERROR;
+}
+
+uint64_t ChunkedDecoder::body_size() const {
+    return _body_size;
+}
+
+}}
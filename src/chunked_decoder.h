@@ -0,0 +1,69 @@
+#ifndef __HTTP_CHUNKED_DECODER_H__
+#define __HTTP_CHUNKED_DECODER_H__
+
+#include "http_common.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace http {
+namespace chunked {
+
+/*
+ * Transfer-Encoding: chunked 增量解码器
+ *
+ * 数据可以任意切分后多次 feed，chunk 数据原样交给 sink，
+ * 解码器自身只保存状态，不缓存包体
+ */
+class ChunkedDecoder {
+public:
+    enum STATE {
+        SIZE = 0,       // chunk-size
+        SIZE_EXT,       // chunk-ext，忽略
+        SIZE_LF,
+        DATA,           // chunk-data
+        DATA_CR,
+        DATA_LF,
+        TRAILER,        // trailer 行首
+        TRAILER_LINE,
+        TRAILER_LF,
+        DONE,
+        ERROR
+    };
+
+    ChunkedDecoder();
+
+    void reset();
+
+    /*
+     * 功能 : 增量解码
+     * data : 待解码数据
+     * size : 数据长度
+     * sink : chunk 数据输出
+     * ret  : 消费的字节数，解码完成后剩余的数据不会被消费
+     */
+    size_t feed(const char* data, size_t size, const http::common::BodySink& sink);
+
+    /*
+     * DATA 状态下当前 chunk 的剩余字节数，
+     * 调用方可以把这部分数据直接读入自己的缓冲区，再通过 skip 推进状态
+     */
+    uint64_t chunk_remaining() const;
+    void skip(size_t size);
+
+    bool done() const;
+    bool error() const;
+
+    // 已解码的包体长度
+    uint64_t body_size() const;
+
+private:
+    STATE _state;
+    uint64_t _chunk_size;
+    uint64_t _body_size;
+    bool _size_digits;
+};
+
+}}
+
+#endif
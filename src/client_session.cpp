@@ -0,0 +1,813 @@
+#include "client_session.h"
+
+#include <cstdlib>
+#include <istream>
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "http_client.h"
+#include "utils.h"
+
+using namespace std;
+using boost::asio::ip::tcp;
+using http::request::Request;
+using http::response::Response;
+using http::response::TimingInfo;
+using http::response::RedirectHop;
+
+namespace http {
+namespace httpclient {
+
+// 直接读入包体时单次读取的上限，避免一次扩容过多
+static const size_t MAX_DIRECT_READ = 1 << 20;
+// 流式输出时的读缓冲
+static const size_t SCRATCH_SIZE = 64 * 1024;
+// 前一次连接尝试没有结果时，发起下一次尝试的间隔（RFC 8305 推荐 250ms）
+static const std::chrono::milliseconds CONNECT_ATTEMPT_DELAY(250);
+// 最多跟随的跳转次数
+static const int MAX_REDIRECTS = 5;
+// content-length 包体预留内存的上限
+static const size_t MAX_RESERVE = 64 << 20;
+
+// 幂等的方法，请求可能已被服务端处理时也可以重发（RFC 7230 6.3.1）
+static bool is_idempotent(const string& method) {
+    for (const char* name : {"GET", "HEAD", "OPTIONS", "PUT", "DELETE", "TRACE"}) {
+        if (boost::iequals(method, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ClientSession::ClientSession(HttpClient& client,
+                             const string& url,
+                             const string& method,
+                             map<string, string>* headers,
+                             const string& data,
+                             BodySink sink,
+                             int timeout_ms,
+                             int redirect_count,
+                             ResponseHandler handler)
+    : _client(client),
+      _strand(client._io_context.get_executor()),
+      _deadline(client._io_context),
+      _url(url),
+      _method(method),
+      _data(data),
+      _sink(sink),
+      _timeout_ms(timeout_ms),
+      _redirect_count(redirect_count),
+      _handler(handler),
+      _port_number(0),
+      _next_endpoint(0),
+      _attempt_timer(client._io_context),
+      _connecting(false),
+      _reserved(false),
+      _waiting(false),
+      _resolving(false),
+      _content_length(0),
+      _keep_alive(false),
+      _stream_body(false),
+      _timed_out(false),
+      _retried(false),
+      _finished(false) {
+    if (headers != nullptr) {
+        _headers = *headers;
+    }
+}
+
+double ClientSession::elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+void ClientSession::start() {
+    auto self = shared_from_this();
+    _deadline.expires_after(std::chrono::milliseconds(_timeout_ms));
+    _deadline.async_wait(boost::asio::bind_executor(_strand,
+        [self, this](const boost::system::error_code& ec) { on_deadline(ec); }));
+
+    // 回调总是在 io_context 中执行，不会在 async_request 内部直接调用
+    boost::asio::post(_strand, [self, this]() { begin(); });
+}
+
+void ClientSession::begin() {
+    _start = std::chrono::steady_clock::now();
+
+    // 解析 协议头、host、port
+    if (!_client.extract_host_port(_url, _protocol, _host, _port)) {
+        finish("not valid url!");
+        return;
+    }
+    // 支持 http、https 协议
+    if (_protocol != "http" && _protocol != "https") {
+        finish("protocol error, only support http and https!");
+        return;
+    }
+    if (_port.empty() || _port.size() > 5 || _port.find_first_not_of("0123456789") != string::npos
+        || stoi(_port) > 65535) {
+        finish("not valid url!");
+        return;
+    }
+    _port_number = static_cast<unsigned short>(stoi(_port));
+
+    _request = Request();
+    _client.build_request_message(_url, _method, _host, _data, &_headers, _request);
+    _request_message = _request.to_string();
+    _key = _protocol + "://" + _host + ":" + _port;
+    acquire();
+}
+
+void ClientSession::acquire() {
+    // 优先复用空闲连接
+    _conn = _client._pool.acquire(_key);
+    TimingInfo& timing = _response.setTiming();
+    timing.queue = elapsed_ms(_start);
+    if (_conn != nullptr) {
+        timing.reused = true;
+        write_request();
+        return;
+    }
+
+    if (_client._pool.reserve(_key)) {
+        _reserved = true;
+        resolve();
+        return;
+    }
+
+    // 连接数已满，等待其它请求归还连接
+    _waiting = true;
+    auto self = shared_from_this();
+    _client._pool.wait(_key, [self, this]() -> bool {
+        // 可能在其它线程调用，只负责投递
+        if (!_waiting.exchange(false)) {
+            return false;
+        }
+        boost::asio::post(_strand, [self, this]() { acquire(); });
+        return true;
+    });
+}
+
+void ClientSession::resolve() {
+    if (_timed_out) {
+        finish("resolve timeout");
+        return;
+    }
+
+    auto self = shared_from_this();
+    _phase_start = std::chrono::steady_clock::now();
+    _resolving = true;
+    _client._dns->async_resolve(_host, [self, this](const string& error, const address_list& addresses) {
+        // 命中缓存时在本 strand 中直接执行，否则在解析完成的线程中回调
+        boost::asio::dispatch(_strand, [self, this, error, addresses]() {
+            // 已经超时结束
+            if (!_resolving) {
+                return;
+            }
+            _resolving = false;
+            _response.setTiming().dns = elapsed_ms(_phase_start);
+            if (!error.empty()) {
+                finish(error);
+                return;
+            }
+            connect(addresses);
+        });
+    });
+}
+
+void ClientSession::connect(const address_list& addresses) {
+    if (_timed_out) {
+        finish("connect timeout");
+        return;
+    }
+    // 固定映射或解析结果可能为空
+    if (addresses.empty()) {
+        finish("connect error");
+        return;
+    }
+
+    // 名额转移到连接上，结束时由 release 归还
+    _conn.reset(new ClientConnection(_client._io_context, _key,
+                                     _protocol == "https" ? &_client._ssl_ctx : nullptr));
+    _reserved = false;
+
+    // 从第一个地址的协议族开始，两个协议族交替
+    _endpoints.clear();
+    _next_endpoint = 0;
+    vector<tcp::endpoint> first, second;
+    for (const auto& address : addresses) {
+        if (address.is_v6() == addresses.front().is_v6()) {
+            first.push_back(tcp::endpoint(address, _port_number));
+        } else {
+            second.push_back(tcp::endpoint(address, _port_number));
+        }
+    }
+    for (size_t i = 0; i < first.size() || i < second.size(); ++i) {
+        if (i < first.size()) {
+            _endpoints.push_back(first[i]);
+        }
+        if (i < second.size()) {
+            _endpoints.push_back(second[i]);
+        }
+    }
+
+    _connecting = true;
+    _phase_start = std::chrono::steady_clock::now();
+    start_attempt();
+}
+
+void ClientSession::start_attempt() {
+    auto self = shared_from_this();
+    auto socket = std::make_shared<tcp::socket>(_client._io_context);
+    _attempts.push_back(socket);
+    socket->async_connect(_endpoints[_next_endpoint++], boost::asio::bind_executor(_strand,
+        [self, this, socket](const boost::system::error_code& ec) { on_attempt(socket, ec); }));
+
+    if (_next_endpoint < _endpoints.size()) {
+        _attempt_timer.expires_after(CONNECT_ATTEMPT_DELAY);
+        _attempt_timer.async_wait(boost::asio::bind_executor(_strand,
+            [self, this](const boost::system::error_code& ec) {
+                if (!ec && _connecting && !_timed_out && _next_endpoint < _endpoints.size()) {
+                    start_attempt();
+                }
+            }));
+    }
+}
+
+void ClientSession::on_attempt(const std::shared_ptr<tcp::socket>& socket,
+                               const boost::system::error_code& ec) {
+    // 已经有其它尝试胜出
+    if (!_connecting) {
+        return;
+    }
+
+    if (ec) {
+        _attempts.erase(std::find(_attempts.begin(), _attempts.end(), socket));
+        // 失败时不等待间隔，立即尝试下一个地址
+        if (!_timed_out && _next_endpoint < _endpoints.size()) {
+            _attempt_timer.cancel();
+            start_attempt();
+            return;
+        }
+        if (!_attempts.empty()) {
+            return;
+        }
+        _connecting = false;
+        _response.setTiming().connect = elapsed_ms(_phase_start);
+        fail("connect");
+        return;
+    }
+
+    _connecting = false;
+    _attempt_timer.cancel();
+    for (auto& attempt : _attempts) {
+        if (attempt != socket) {
+            boost::system::error_code ignored;
+            attempt->close(ignored);
+        }
+    }
+    _attempts.clear();
+    _conn->lowest_layer() = std::move(*socket);
+
+    _response.setTiming().connect = elapsed_ms(_phase_start);
+    // 请求报文一次写出，不需要 Nagle
+    boost::system::error_code ignored;
+    _conn->lowest_layer().set_option(tcp::no_delay(true), ignored);
+
+    if (_conn->https) {
+        handshake();
+    } else {
+        write_request();
+    }
+}
+
+void ClientSession::handshake() {
+    // Set SNI Hostname (many hosts need this to handshake successfully)
+    // https://github.com/boostorg/beast/blob/develop/example/http/client/sync-ssl/http_client_sync_ssl.cpp
+    SSL* ssl = _conn->ssl_stream->native_handle();
+    if (!SSL_set_tlsext_host_name(ssl, _host.c_str())) {
+        boost::system::error_code ec{static_cast<int>(::ERR_get_error()), boost::asio::error::get_ssl_category()};
+        finish(ec.message());
+        return;
+    }
+    // 有缓存的会话时尝试简化握手
+    _client._tls_sessions.prepare(ssl, &_conn->key);
+
+    auto self = shared_from_this();
+    _phase_start = std::chrono::steady_clock::now();
+    _conn->ssl_stream->async_handshake(boost::asio::ssl::stream_base::client,
+        boost::asio::bind_executor(_strand, [self, this](const boost::system::error_code& ec) {
+            SSL* ssl = _conn->ssl_stream->native_handle();
+            _client._tls_sessions.handshake_done(ssl, _key, !ec);
+            TimingInfo& timing = _response.setTiming();
+            timing.tls = elapsed_ms(_phase_start);
+            timing.tls_resumed = !ec && SSL_session_reused(ssl);
+            if (ec) {
+                fail("handshake");
+                return;
+            }
+            write_request();
+        }));
+}
+
+void ClientSession::write_request() {
+    auto self = shared_from_this();
+    _phase_start = std::chrono::steady_clock::now();
+    _conn->async_write(boost::asio::buffer(_request_message), boost::asio::bind_executor(_strand,
+        [self, this](const boost::system::error_code& ec, size_t) {
+            if (ec) {
+                fail("write");
+                return;
+            }
+            wait_response();
+        }));
+}
+
+void ClientSession::wait_response() {
+    auto self = shared_from_this();
+    _conn->lowest_layer().async_wait(tcp::socket::wait_read, boost::asio::bind_executor(_strand,
+        [self, this](const boost::system::error_code& ec) {
+            if (ec) {
+                fail("read");
+                return;
+            }
+            _response.setTiming().ttfb = elapsed_ms(_phase_start);
+            read_header();
+        }));
+}
+
+void ClientSession::read_header() {
+    auto self = shared_from_this();
+    _conn->async_read_until(_buffer, CRLFCRLF, boost::asio::bind_executor(_strand,
+        [self, this](const boost::system::error_code& ec, size_t) {
+            if (ec) {
+                fail("read");
+                return;
+            }
+
+            // 解析状态行
+            istream response_stream(&_buffer);
+            string line;
+            getline(response_stream, line);
+            boost::trim(line);
+            if (!_client.parse_response_line(line, _response)) {
+                finish("error response_line" + line);
+                return;
+            }
+
+            // 解析响应头，read_until 多读的包体留在 _buffer 中
+            while (getline(response_stream, line) && line != "\r") {
+                size_t pos = line.find(":");
+                if (pos == string::npos) { continue; }
+                string key = boost::trim_copy(line.substr(0, pos));
+                string value = boost::trim_copy(line.substr(pos+1));
+                _response.setHeader(key, value);
+            }
+
+            // 拦截 4xx 5xx
+            const string& code = _response.StatusCode();
+            if (code[0] == '4' || code[0] == '5') {
+                finish("HTTP Error " + code + ":" + _response.StatusDescribe());
+                return;
+            }
+
+            // 是否可以复用连接
+            string connection = boost::to_lower_copy(_response.Header("connection"));
+            _keep_alive = boost::to_lower_copy(_request.Header("connection")) != "close"
+                          && (_response.Protocol() == "HTTP/1.1" ? connection != "close" : connection == "keep-alive");
+
+            read_body();
+        }));
+}
+
+void ClientSession::read_body() {
+    // HEAD、1xx、204、304 没有包体
+    const string& code = _response.StatusCode();
+    if (boost::iequals(_request.Method(), "head")
+        || code[0] == '1' || code == "204" || code == "304") {
+        finish("");
+    // chunked
+    } else if (boost::iequals(_response.Header("transfer-encoding"), "chunked")) {
+        prepare_body();
+        read_chunked();
+    // content-length
+    } else if (!_response.Header("content-length").empty()) {
+        const string& length = _response.Header("content-length");
+        if (length.find_first_not_of("0123456789") != string::npos) {
+            finish("invalid content-length: " + length);
+            return;
+        }
+        _content_length = strtoull(length.c_str(), nullptr, 10);
+        prepare_body();
+        read_content_length();
+    } else {
+        // 没有长度信息时以连接关闭为结束，不能复用
+        // example: http://memory.thethirdmedia.com/
+        _keep_alive = false;
+        prepare_body();
+        read_until_close();
+    }
+}
+
+void ClientSession::prepare_body() {
+    // 会跟随跳转的响应，包体不需要
+    if (follow_redirect()) {
+        return;
+    }
+
+    bool gzip = boost::iequals(_response.Header("Content-Encoding"), "gzip");
+    if (!_sink && !gzip) {
+        return;
+    }
+
+    _stream_body = true;
+    _scratch.resize(SCRATCH_SIZE);
+
+    _output = _sink;
+    if (!_output) {
+        string& body = _response.setData();
+        _output = [&body](const char* data, size_t size) { body.append(data, size); };
+    }
+    if (gzip) {
+        _gzip.reset(new http::utils::GzipDecompressor(_output));
+    }
+}
+
+void ClientSession::write_body(const char* data, size_t size) {
+    if (_gzip != nullptr) {
+        _gzip->write(data, size);
+    } else {
+        _output(data, size);
+    }
+}
+
+template <class Handler>
+void ClientSession::read_scratch(uint64_t size, Handler handler) {
+    size_t want = static_cast<size_t>(std::min<uint64_t>(size, _scratch.size()));
+    auto self = shared_from_this();
+    _conn->async_read(boost::asio::buffer(_scratch.data(), want),
+                      boost::asio::transfer_at_least(1),
+                      boost::asio::bind_executor(_strand, [self, this, handler](const boost::system::error_code& ec, size_t n) {
+                          if (ec) {
+                              fail("read");
+                              return;
+                          }
+                          try {
+                              write_body(_scratch.data(), n);
+                          } catch (const exception& e) {
+                              finish(string("body error: ") + e.what());
+                              return;
+                          }
+                          handler(n);
+                      }));
+}
+
+void ClientSession::read_content_length() {
+    if (_stream_body) {
+        // read_until 多读的部分
+        size_t n = static_cast<size_t>(std::min<uint64_t>(_buffer.size(), _content_length));
+        if (n > 0) {
+            try {
+                write_body(static_cast<const char*>(_buffer.data().data()), n);
+            } catch (const exception& e) {
+                finish(string("body error: ") + e.what());
+                return;
+            }
+            _buffer.consume(n);
+            _content_length -= n;
+        }
+
+        if (_content_length == 0) {
+            finish("");
+            return;
+        }
+        auto self = shared_from_this();
+        read_scratch(_content_length, [self, this](size_t n) {
+            _content_length -= n;
+            read_content_length();
+        });
+        return;
+    }
+
+    string& body = _response.setData();
+    if (body.empty()) {
+        // 按声明的长度预留，长度不可信，预留有上限
+        body.reserve(static_cast<size_t>(std::min<uint64_t>(_content_length, MAX_RESERVE)));
+        // read_until 多读的部分，超出长度的数据留在 _buffer
+        size_t n = static_cast<size_t>(std::min<uint64_t>(_buffer.size(), _content_length));
+        body.append(static_cast<const char*>(_buffer.data().data()), n);
+        _buffer.consume(n);
+        _content_length -= n;
+    }
+
+    if (_content_length == 0) {
+        finish("");
+        return;
+    }
+
+    // 剩余部分直接读到包体末尾，不经过 _buffer
+    size_t want = static_cast<size_t>(std::min<uint64_t>(_content_length, MAX_DIRECT_READ));
+    size_t offset = body.size();
+    body.resize(offset + want);
+    auto self = shared_from_this();
+    _conn->async_read(boost::asio::buffer(&body[offset], want),
+                      boost::asio::transfer_all(),
+                      boost::asio::bind_executor(_strand, [self, this, offset](const boost::system::error_code& ec, size_t n) {
+                          // 只保留读到的数据，出错时也一样
+                          _response.setData().resize(offset + n);
+                          if (ec) {
+                              fail("read");
+                              return;
+                          }
+                          _content_length -= n;
+                          read_content_length();
+                      }));
+}
+
+void ClientSession::read_until_close() {
+    // read_until 多读的部分
+    if (_buffer.size() > 0) {
+        const char* data = static_cast<const char*>(_buffer.data().data());
+        if (_stream_body) {
+            try {
+                write_body(data, _buffer.size());
+            } catch (const exception& e) {
+                finish(string("body error: ") + e.what());
+                return;
+            }
+        } else {
+            _response.setData().append(data, _buffer.size());
+        }
+        _buffer.consume(_buffer.size());
+    }
+
+    auto self = shared_from_this();
+    auto on_read = [self, this](const boost::system::error_code& ec, size_t n) {
+        // 服务端关闭连接即包体结束，https 服务端常常不发 close_notify
+        bool closed = ec == boost::asio::error::eof
+                      || ec == boost::asio::ssl::error::stream_truncated;
+        if (!_stream_body) {
+            // 去掉没有读到数据的部分，出错时也一样
+            string& body = _response.setData();
+            body.resize(body.size() - SCRATCH_SIZE + n);
+        }
+        if (ec && !closed) {
+            fail("read");
+            return;
+        }
+        if (_stream_body && n > 0) {
+            try {
+                write_body(_scratch.data(), n);
+            } catch (const exception& e) {
+                finish(string("body error: ") + e.what());
+                return;
+            }
+        }
+        if (closed) {
+            finish("");
+        } else {
+            read_until_close();
+        }
+    };
+
+    if (_stream_body) {
+        _conn->async_read(boost::asio::buffer(_scratch.data(), _scratch.size()),
+                          boost::asio::transfer_at_least(1),
+                          boost::asio::bind_executor(_strand, on_read));
+    } else {
+        string& body = _response.setData();
+        size_t offset = body.size();
+        body.resize(offset + SCRATCH_SIZE);
+        _conn->async_read(boost::asio::buffer(&body[offset], SCRATCH_SIZE),
+                          boost::asio::transfer_at_least(1),
+                          boost::asio::bind_executor(_strand, on_read));
+    }
+}
+
+void ClientSession::read_chunked() {
+    string& body = _response.setData();
+    BodySink sink;
+    if (_stream_body) {
+        sink = [this](const char* data, size_t size) { write_body(data, size); };
+    } else {
+        sink = [&body](const char* data, size_t size) { body.append(data, size); };
+    }
+
+    // 已经读入 _buffer 的部分交给解码器
+    try {
+        while (_buffer.size() > 0 && !_chunked.done() && !_chunked.error()) {
+            const char* data = static_cast<const char*>(_buffer.data().data());
+            _buffer.consume(_chunked.feed(data, _buffer.size(), sink));
+        }
+    } catch (const exception& e) {
+        finish(string("body error: ") + e.what());
+        return;
+    }
+
+    if (_chunked.error()) {
+        finish("chunked error");
+        return;
+    }
+    if (_chunked.done()) {
+        finish("");
+        return;
+    }
+
+    auto self = shared_from_this();
+
+    uint64_t remaining = _chunked.chunk_remaining();
+    if (remaining > 0 && _stream_body) {
+        read_scratch(remaining, [self, this](size_t n) {
+            _chunked.skip(n);
+            read_chunked();
+        });
+        return;
+    }
+
+    // chunk 数据直接读到包体末尾，不经过 _buffer
+    if (remaining > 0) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(remaining, MAX_DIRECT_READ));
+        size_t offset = body.size();
+        body.resize(offset + want);
+        _conn->async_read(boost::asio::buffer(&body[offset], want),
+                          boost::asio::transfer_all(),
+                          boost::asio::bind_executor(_strand, [self, this, offset, want](const boost::system::error_code& ec, size_t n) {
+                              if (ec) {
+                                  // 只保留读到的数据
+                                  _response.setData().resize(offset + n);
+                                  fail("read");
+                                  return;
+                              }
+                              _chunked.skip(want);
+                              read_chunked();
+                          }));
+        return;
+    }
+
+    // chunk-size 行、chunk 结尾的 CRLF 和 trailer 读到 _buffer 解析
+    _conn->async_read(_buffer,
+                      boost::asio::transfer_at_least(1),
+                      boost::asio::bind_executor(_strand, [self, this](const boost::system::error_code& ec, size_t) {
+                          if (ec) {
+                              fail("read");
+                              return;
+                          }
+                          read_chunked();
+                      }));
+}
+
+void ClientSession::on_deadline(const boost::system::error_code& ec) {
+    if (ec == boost::asio::error::operation_aborted || _finished) {
+        return;
+    }
+
+    _timed_out = true;
+    // 排队中没有挂起的异步操作，直接结束
+    if (_waiting.exchange(false)) {
+        finish("connect timeout");
+        return;
+    }
+    // 解析结果是共享的，不能取消，直接结束
+    if (_resolving) {
+        _resolving = false;
+        finish("resolve timeout");
+        return;
+    }
+    // 取消挂起的异步操作，由其回调结束请求
+    if (_conn != nullptr) {
+        _conn->close();
+    }
+    for (auto& attempt : _attempts) {
+        boost::system::error_code ignored;
+        attempt->close(ignored);
+    }
+}
+
+void ClientSession::fail(const string& phase) {
+    finish(_timed_out ? phase + " timeout" : phase + " error");
+}
+
+bool ClientSession::follow_redirect() {
+    if (_redirect_count > MAX_REDIRECTS) {
+        return false;
+    }
+    const string& code = _response.StatusCode();
+    if (code != "301" && code != "302" && code != "303" && code != "307" && code != "308") {
+        return false;
+    }
+    return !_response.Header("Location").empty();
+}
+
+// 请求头的 key 由调用方填写，大小写不固定
+static void erase_header(map<string, string>& headers, const string& key) {
+    for (auto it = headers.begin(); it != headers.end();) {
+        if (boost::iequals(it->first, key)) {
+            it = headers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ClientSession::redirect() {
+    RedirectHop hop;
+    hop.url = _url;
+    hop.status_code = _response.StatusCode();
+    hop.location = _response.Header("Location");
+    hop.timing = _response.Timing();
+    _redirects.push_back(hop);
+
+    string url = _client.build_redirection_url(_url, _response);
+
+    // 301、302、303 改为 GET 并去掉请求体（HEAD 不变），307、308 保持方法和请求体
+    const string& code = hop.status_code;
+    if ((code == "301" || code == "302" || code == "303") && !boost::iequals(_method, "head")) {
+        _method = "GET";
+        _data.clear();
+        erase_header(_headers, "Content-Type");
+        erase_header(_headers, "Content-Length");
+    }
+
+    // 跳到其它站点时不转发认证信息
+    string protocol, host, port;
+    if (!_client.extract_host_port(url, protocol, host, port)
+        || protocol + "://" + host + ":" + port != _key) {
+        erase_header(_headers, "Authorization");
+        erase_header(_headers, "Cookie");
+    }
+
+    _url = url;
+    ++_redirect_count;
+    _response = Response();
+    _buffer.consume(_buffer.size());
+    _chunked.reset();
+    _content_length = 0;
+    _keep_alive = false;
+    _stream_body = false;
+    _output = nullptr;
+    _gzip.reset();
+    _retried = false;
+
+    // 同一站点时 acquire 会取回刚归还的连接
+    begin();
+}
+
+void ClientSession::finish(const string& error) {
+    if (_finished) {
+        return;
+    }
+
+    // 复用的连接可能已被服务端关闭，没有收到响应时换新连接重试
+    // 请求可能已经发出并被处理，POST、PATCH 等不重发
+    bool retry = !error.empty() && !_timed_out && !_retried
+                 && _conn != nullptr && _conn->reused && _response.Protocol().empty()
+                 && is_idempotent(_method);
+
+    if (_conn != nullptr) {
+        // 有多余的数据说明响应边界不可信
+        bool reusable = error.empty() && _keep_alive && _buffer.size() == 0;
+        if (!reusable) {
+            _conn->close();
+        }
+        _client._pool.release(_conn, reusable);
+        _conn.reset();
+    } else if (_reserved) {
+        _reserved = false;
+        _client._pool.cancel(_key);
+    }
+
+    if (retry) {
+        _retried = true;
+        _response = Response();
+        _buffer.consume(_buffer.size());
+        _keep_alive = false;
+        acquire();
+        return;
+    }
+
+    _response.setTiming().total = elapsed_ms(_start);
+
+    // 3xx Redirection，截止时间不变
+    if (error.empty() && follow_redirect()) {
+        redirect();
+        return;
+    }
+
+    _finished = true;
+    _deadline.cancel();
+    _response.setRedirects(_redirects);
+
+    string err = error;
+    if (err.empty() && _gzip != nullptr) {
+        // 输出解压器中剩余的数据，并检查 gzip 是否完整
+        try {
+            _gzip->finish();
+        } catch (const exception& e) {
+            err = string("gzip error: ") + e.what();
+        }
+    }
+
+    _handler(err, _response);
+}
+
+}}
@@ -0,0 +1,165 @@
+#ifndef __HTTP_CLIENT_SESSION_H__
+#define __HTTP_CLIENT_SESSION_H__
+
+#include <map>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <functional>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "request.h"
+#include "response.h"
+#include "utils.h"
+#include "chunked_decoder.h"
+#include "connection_pool.h"
+#include "dns_cache.h"
+
+namespace http {
+namespace httpclient {
+
+class HttpClient;
+
+/*
+ * 异步请求回调
+ * error 为空表示成功，否则 response 中只有已经收到的部分
+ */
+typedef std::function<void(const std::string& error, http::response::Response& response)> ResponseHandler;
+
+/*
+ * 单个异步请求
+ *
+ * 取连接（复用 / 新建 / 排队） -> 解析 -> 连接 -> 握手 -> 发送 -> 读响应头 -> 读包体
+ * 所有回调都在同一个 strand 上执行，整个请求只有一个超时定时器
+ *
+ * 指定 sink 时包体（gzip 已解压）按到达顺序交给 sink，不保存在 Response 中
+ */
+class ClientSession : public std::enable_shared_from_this<ClientSession> {
+public:
+    ClientSession(HttpClient& client,
+                  const std::string& url,
+                  const std::string& method,
+                  std::map<std::string, std::string>* headers,
+                  const std::string& data,
+                  http::common::BodySink sink,
+                  int timeout_ms,
+                  int redirect_count,
+                  ResponseHandler handler);
+
+    void start();
+
+private:
+    typedef boost::asio::strand<boost::asio::io_context::executor_type> strand_type;
+
+    // 解析 _url 并发起请求，每次跳转重新调用
+    void begin();
+    // 取空闲连接，没有则新建，超过 max_per_host 时排队
+    void acquire();
+    void resolve();
+    /*
+     * Happy Eyeballs（RFC 8305）：IPv6 / IPv4 地址交错排列，
+     * 上一次尝试 250ms 内没有结果（或已经失败）时并行尝试下一个地址，最先连上的胜出
+     */
+    void connect(const address_list& addresses);
+    void start_attempt();
+    void on_attempt(const std::shared_ptr<boost::asio::ip::tcp::socket>& socket,
+                    const boost::system::error_code& ec);
+    void handshake();
+    void write_request();
+    // 等待第一个字节，记录 ttfb
+    void wait_response();
+    void read_header();
+    void read_body();
+    // 根据 sink 和 Content-Encoding 决定包体的输出方式
+    void prepare_body();
+    // 流式输出，可能抛出异常（解压错误、sink 出错）
+    void write_body(const char* data, size_t size);
+    void read_content_length();
+    void read_chunked();
+    // 没有 content-length 和 chunked 时读到连接关闭
+    void read_until_close();
+    // 流式输出时把最多 size 字节读到 _scratch
+    template <class Handler>
+    void read_scratch(uint64_t size, Handler handler);
+    bool follow_redirect();
+    // 在当前 session 中请求跳转地址
+    void redirect();
+
+    void on_deadline(const boost::system::error_code& ec);
+    // 异步操作出错时的统一处理，结果为 "<phase> error" 或超时后的 "<phase> timeout"
+    void fail(const std::string& phase);
+    void finish(const std::string& error);
+
+    // 距 since 的毫秒数
+    static double elapsed_ms(std::chrono::steady_clock::time_point since);
+
+    HttpClient& _client;
+    strand_type _strand;
+    boost::asio::steady_timer _deadline;
+
+    std::string _url;
+    std::string _method;
+    std::map<std::string, std::string> _headers;
+    std::string _data;
+    http::common::BodySink _sink;
+    int _timeout_ms;
+    int _redirect_count;
+    ResponseHandler _handler;
+
+    std::string _protocol;
+    std::string _host;
+    std::string _port;
+    unsigned short _port_number;
+    std::string _key;
+
+    http::request::Request _request;
+    std::string _request_message;
+    http::response::Response _response;
+
+    connection_ptr _conn;
+    // 建立连接时依次尝试的地址
+    std::vector<boost::asio::ip::tcp::endpoint> _endpoints;
+    size_t _next_endpoint;
+    // 进行中的连接尝试，胜出的 socket 转移到 _conn
+    std::vector<std::shared_ptr<boost::asio::ip::tcp::socket>> _attempts;
+    boost::asio::steady_timer _attempt_timer;
+    bool _connecting;
+
+    // 已占用新建连接的名额，连接还没有建立
+    bool _reserved;
+    // 正在 ConnectionPool 中排队，ConnectionPool 可能在其它线程唤醒
+    std::atomic<bool> _waiting;
+    // 正在等待 DnsCache 的结果
+    bool _resolving;
+
+    boost::asio::streambuf _buffer;
+    http::chunked::ChunkedDecoder _chunked;
+    uint64_t _content_length;
+    bool _keep_alive;
+
+    // 包体经过 write_body 输出（指定了 sink 或需要解压）
+    bool _stream_body;
+    // 最终输出：调用方的 sink 或追加到 Response 的包体
+    http::common::BodySink _output;
+    std::unique_ptr<http::utils::GzipDecompressor> _gzip;
+    std::vector<char> _scratch;
+
+    // 已经跟随的跳转
+    std::vector<http::response::RedirectHop> _redirects;
+
+    // 当前这一跳的开始时间，超时从 start() 开始计算
+    std::chrono::steady_clock::time_point _start;
+    // 当前阶段开始时间
+    std::chrono::steady_clock::time_point _phase_start;
+
+    bool _timed_out;
+    bool _retried;
+    bool _finished;
+};
+
+}}
+
+#endif
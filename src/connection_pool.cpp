@@ -0,0 +1,207 @@
+#include "connection_pool.h"
+
+#include <sys/socket.h>
+#include <cerrno>
+
+using boost::asio::ip::tcp;
+
+namespace http {
+namespace httpclient {
+
+ClientConnection::ClientConnection(boost::asio::io_context& io_context,
+                                   const std::string& key,
+                                   boost::asio::ssl::context* ssl_ctx)
+    : key(key),
+      https(ssl_ctx != nullptr),
+      request_count(0),
+      reused(false) {
+    if (https) {
+        ssl_stream.reset(new ssl_socket(io_context, *ssl_ctx));
+    } else {
+        socket.reset(new tcp::socket(io_context));
+    }
+}
+
+tcp::socket& ClientConnection::lowest_layer() {
+    return https ? ssl_stream->next_layer() : *socket;
+}
+
+void ClientConnection::close() {
+    boost::system::error_code ec;
+    lowest_layer().close(ec);
+}
+
+bool ClientConnection::stale() {
+    tcp::socket& sock = lowest_layer();
+    if (!sock.is_open()) {
+        return true;
+    }
+    // 空闲连接上不应该有数据，可读说明对端已关闭或协议出错
+    if (https) {
+        // 已经读入 OpenSSL 但没有被取走的数据（同一个 TLS 记录中超出响应的部分）
+        SSL* ssl = ssl_stream->native_handle();
+        if (SSL_has_pending(ssl) || BIO_pending(SSL_get_rbio(ssl)) > 0) {
+            return true;
+        }
+    }
+    char c;
+    ssize_t n = ::recv(sock.native_handle(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return !(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+ConnectionPool::ConnectionPool(const PoolOptions& options)
+    : _options(options),
+      _last_evict(std::chrono::steady_clock::now()) {
+}
+
+ConnectionPool::~ConnectionPool() {
+    clear();
+}
+
+bool ConnectionPool::expired(const connection_ptr& conn,
+                             std::chrono::steady_clock::time_point now) const {
+    return now - conn->last_used > std::chrono::seconds(_options.idle_timeout);
+}
+
+connection_ptr ConnectionPool::acquire(const std::string& key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _hosts.find(key);
+    if (it == _hosts.end()) {
+        return nullptr;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    std::deque<connection_ptr>& idle = it->second.idle;
+    // 优先使用最近归还的连接
+    while (!idle.empty()) {
+        connection_ptr conn = idle.back();
+        idle.pop_back();
+        if (expired(conn, now) || conn->stale()) {
+            conn->close();
+            continue;
+        }
+        conn->reused = true;
+        ++it->second.active;
+        return conn;
+    }
+    return nullptr;
+}
+
+bool ConnectionPool::reserve(const std::string& key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    HostEntry& entry = _hosts[key];
+    if (entry.active + entry.idle.size() >= _options.max_per_host) {
+        // 先关掉空闲连接腾出名额
+        if (entry.idle.empty()) {
+            return false;
+        }
+        entry.idle.front()->close();
+        entry.idle.pop_front();
+    }
+    ++entry.active;
+    return true;
+}
+
+void ConnectionPool::release(connection_ptr conn, bool reusable) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto now = std::chrono::steady_clock::now();
+        HostEntry& entry = _hosts[conn->key];
+        if (entry.active > 0) {
+            --entry.active;
+        }
+
+        ++conn->request_count;
+        conn->last_used = now;
+        conn->reused = false;
+
+        if (!reusable
+            || conn->request_count >= _options.max_requests_per_connection
+            || entry.idle.size() >= _options.max_idle_per_host) {
+            conn->close();
+        } else {
+            entry.idle.push_back(conn);
+        }
+
+        // 每秒最多清理一次其它 host 的过期连接
+        if (now - _last_evict > std::chrono::seconds(1)) {
+            evict_expired(now);
+            _last_evict = now;
+        }
+    }
+    notify(conn->key);
+}
+
+void ConnectionPool::cancel(const std::string& key) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        HostEntry& entry = _hosts[key];
+        if (entry.active > 0) {
+            --entry.active;
+        }
+    }
+    notify(key);
+}
+
+void ConnectionPool::wait(const std::string& key, std::function<bool()> callback) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        HostEntry& entry = _hosts[key];
+        // 排队前名额可能已经释放
+        if (entry.active + entry.idle.size() >= _options.max_per_host || !entry.waiters.empty()) {
+            entry.waiters.push_back(callback);
+            return;
+        }
+    }
+    callback();
+}
+
+void ConnectionPool::notify(const std::string& key) {
+    while (true) {
+        std::function<bool()> callback;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _hosts.find(key);
+            if (it == _hosts.end() || it->second.waiters.empty()) {
+                return;
+            }
+            callback = it->second.waiters.front();
+            it->second.waiters.pop_front();
+        }
+        if (callback()) {
+            return;
+        }
+    }
+}
+
+void ConnectionPool::evict_expired(std::chrono::steady_clock::time_point now) {
+    for (auto it = _hosts.begin(); it != _hosts.end();) {
+        std::deque<connection_ptr>& idle = it->second.idle;
+        // idle 按归还时间排列，最早的在前面
+        while (!idle.empty() && expired(idle.front(), now)) {
+            idle.front()->close();
+            idle.pop_front();
+        }
+        if (idle.empty() && it->second.active == 0 && it->second.waiters.empty()) {
+            it = _hosts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ConnectionPool::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& host : _hosts) {
+        for (auto& conn : host.second.idle) {
+            conn->close();
+        }
+        host.second.idle.clear();
+    }
+}
+
+const PoolOptions& ConnectionPool::options() const {
+    return _options;
+}
+
+}}
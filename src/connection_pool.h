@@ -0,0 +1,161 @@
+#ifndef __HTTP_CONNECTION_POOL_H__
+#define __HTTP_CONNECTION_POOL_H__
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+namespace http {
+namespace httpclient {
+
+typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> ssl_socket;
+
+/*
+ * 客户端连接
+ * http 使用 socket，https 使用 ssl_stream
+ */
+struct ClientConnection {
+    /*
+     * ssl_ctx 为 nullptr 时是 http 连接，否则为 https 连接，
+     * ssl_ctx 由 HttpClient 持有，所有连接共用
+     */
+    ClientConnection(boost::asio::io_context& io_context,
+                     const std::string& key,
+                     boost::asio::ssl::context* ssl_ctx);
+
+    boost::asio::ip::tcp::socket& lowest_layer();
+    void close();
+
+    // 根据 http/https 选择底层 stream 的异步读写
+    template <class ConstBuffer, class Handler>
+    void async_write(const ConstBuffer& buffer, Handler handler) {
+        if (https) {
+            boost::asio::async_write(*ssl_stream, buffer, handler);
+        } else {
+            boost::asio::async_write(*socket, buffer, handler);
+        }
+    }
+
+    template <class Handler>
+    void async_read_until(boost::asio::streambuf& buffer, const std::string& delim, Handler handler) {
+        if (https) {
+            boost::asio::async_read_until(*ssl_stream, buffer, delim, handler);
+        } else {
+            boost::asio::async_read_until(*socket, buffer, delim, handler);
+        }
+    }
+
+    // buffer 可以是 streambuf 或 mutable_buffer
+    template <class Buffer, class Condition, class Handler>
+    void async_read(Buffer&& buffer, Condition condition, Handler handler) {
+        if (https) {
+            boost::asio::async_read(*ssl_stream, buffer, condition, handler);
+        } else {
+            boost::asio::async_read(*socket, buffer, condition, handler);
+        }
+    }
+
+    /*
+     * 空闲连接是否已被对端关闭或收到了多余的数据
+     */
+    bool stale();
+
+    // scheme://host:port
+    std::string key;
+    bool https;
+
+    std::unique_ptr<boost::asio::ip::tcp::socket> socket;
+    std::unique_ptr<ssl_socket> ssl_stream;
+
+    std::chrono::steady_clock::time_point last_used;
+    // 已经在该连接上完成的请求数
+    size_t request_count;
+    // 当前请求使用的是复用的连接
+    bool reused;
+};
+
+typedef std::shared_ptr<ClientConnection> connection_ptr;
+
+struct PoolOptions {
+    // 每个 host 的最大连接数（使用中 + 空闲）
+    size_t max_per_host = 8;
+    // 每个 host 的最大空闲连接数
+    size_t max_idle_per_host = 4;
+    // 空闲超时（秒）
+    int idle_timeout = 30;
+    // 单个连接最多处理的请求数
+    size_t max_requests_per_connection = 1000;
+};
+
+/*
+ * 按 scheme://host:port 缓存 keep-alive 连接
+ */
+class ConnectionPool {
+public:
+    explicit ConnectionPool(const PoolOptions& options = PoolOptions());
+    ~ConnectionPool();
+
+    /*
+     * 取一个空闲连接，没有可用连接时返回 nullptr
+     * 过期或已被对端关闭的连接直接丢弃
+     */
+    connection_ptr acquire(const std::string& key);
+
+    /*
+     * 为 key 新建连接占一个名额，超过 max_per_host 返回 false
+     */
+    bool reserve(const std::string& key);
+
+    /*
+     * 请求结束后归还连接，reusable 为 false 时关闭
+     */
+    void release(connection_ptr conn, bool reusable);
+
+    /*
+     * 新建连接失败时归还 reserve 占用的名额
+     */
+    void cancel(const std::string& key);
+
+    /*
+     * reserve 失败时排队，key 有连接归还或名额释放时按顺序回调
+     * callback 返回 false 表示已不再等待（例如已超时），继续唤醒下一个
+     */
+    void wait(const std::string& key, std::function<bool()> callback);
+
+    /*
+     * 关闭所有空闲连接
+     */
+    void clear();
+
+    const PoolOptions& options() const;
+
+private:
+    struct HostEntry {
+        std::deque<connection_ptr> idle;
+        // 使用中的连接数
+        size_t active = 0;
+        std::deque<std::function<bool()>> waiters;
+    };
+
+    // 唤醒一个等待者，需要在锁外调用
+    void notify(const std::string& key);
+
+    bool expired(const connection_ptr& conn,
+                 std::chrono::steady_clock::time_point now) const;
+    void evict_expired(std::chrono::steady_clock::time_point now);
+
+    PoolOptions _options;
+    std::mutex _mutex;
+    std::unordered_map<std::string, HostEntry> _hosts;
+    std::chrono::steady_clock::time_point _last_evict;
+};
+
+}}
+
+#endif
@@ -0,0 +1,210 @@
+#include "dns_cache.h"
+
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+using boost::asio::ip::tcp;
+
+namespace http {
+namespace httpclient {
+
+DnsCache::DnsCache(boost::asio::io_context& io_context, const DnsOptions& options)
+    : _io_context(io_context),
+      _options(options) {
+}
+
+void DnsCache::async_resolve(const string& host, ResolveHandler handler) {
+    // ip 地址不需要解析
+    boost::system::error_code ec;
+    boost::asio::ip::address address = boost::asio::ip::make_address(host, ec);
+    if (!ec) {
+        handler("", address_list(1, address));
+        return;
+    }
+
+    auto now = clock::now();
+    address_list addresses;
+    string error;
+    bool refresh = false;
+    bool miss = false;
+    {
+        lock_guard<mutex> lock(_mutex);
+        Entry& entry = _entries[host];
+        if (entry.pinned || now < entry.expires) {
+            if (entry.error.empty()) {
+                ++_stats.hits;
+            } else {
+                ++_stats.negative_hits;
+            }
+            addresses = entry.addresses;
+            error = entry.error;
+
+            // 快过期时提前刷新，本次仍使用旧结果
+            if (!entry.pinned && entry.error.empty() && !entry.resolving
+                && entry.expires - now < chrono::seconds(_options.refresh_ahead)) {
+                entry.resolving = true;
+                refresh = true;
+                ++_stats.refreshes;
+            }
+        } else {
+            ++_stats.misses;
+            miss = true;
+            entry.waiters.push_back(handler);
+            if (entry.resolving) {
+                return;
+            }
+            entry.resolving = true;
+            evict(now);
+        }
+    }
+
+    if (miss || refresh) {
+        start_resolve(host);
+    }
+    if (!miss) {
+        handler(error, addresses);
+    }
+}
+
+void DnsCache::start_resolve(const string& host) {
+    auto self = shared_from_this();
+    auto resolver = make_shared<tcp::resolver>(_io_context);
+    resolver->async_resolve(host, "",
+        [self, resolver, host](const boost::system::error_code& ec, tcp::resolver::results_type results) {
+            self->on_resolved(host, ec, results);
+        });
+}
+
+void DnsCache::on_resolved(const string& host,
+                           const boost::system::error_code& ec,
+                           const tcp::resolver::results_type& results) {
+    address_list addresses;
+    string error;
+    if (ec) {
+        error = "resolve error: " + ec.message();
+    } else {
+        for (const auto& result : results) {
+            boost::asio::ip::address address = result.endpoint().address();
+            if (find(addresses.begin(), addresses.end(), address) == addresses.end()) {
+                addresses.push_back(address);
+            }
+        }
+        if (addresses.empty()) {
+            error = "resolve error: no address";
+        }
+    }
+
+    vector<ResolveHandler> waiters;
+    {
+        lock_guard<mutex> lock(_mutex);
+        auto now = clock::now();
+        Entry& entry = _entries[host];
+        entry.resolving = false;
+        waiters.swap(entry.waiters);
+
+        if (entry.pinned) {
+            // 解析期间被固定，以固定映射为准
+            addresses = entry.addresses;
+            error.clear();
+        } else if (!error.empty() && entry.error.empty() && now < entry.expires) {
+            // 后台刷新失败，旧结果继续使用到过期
+        } else {
+            entry.addresses = addresses;
+            entry.error = error;
+            entry.expires = now + chrono::seconds(error.empty() ? _options.ttl : _options.negative_ttl);
+        }
+    }
+
+    for (auto& waiter : waiters) {
+        waiter(error, addresses);
+    }
+}
+
+void DnsCache::evict(clock::time_point now) {
+    if (_entries.size() <= _options.max_entries) {
+        return;
+    }
+
+    // 先淘汰过期的，仍然超出时淘汰到 90%，避免每次插入都遍历
+    size_t target = _options.max_entries - _options.max_entries / 10;
+    for (int pass = 0; pass < 2 && _entries.size() > target; ++pass) {
+        for (auto it = _entries.begin(); it != _entries.end() && _entries.size() > target;) {
+            const Entry& entry = it->second;
+            if (!entry.pinned && !entry.resolving && (pass == 1 || now >= entry.expires)) {
+                it = _entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void DnsCache::pin(const string& host, const address_list& addresses) {
+    lock_guard<mutex> lock(_mutex);
+    Entry& entry = _entries[host];
+    entry.pinned = true;
+    entry.addresses = addresses;
+    entry.error.clear();
+}
+
+int DnsCache::load_hosts(const string& path) {
+    ifstream fin(path);
+    if (!fin.is_open()) {
+        return -1;
+    }
+
+    // 同一个 host 可以出现在多行
+    map<string, address_list> hosts;
+    string line;
+    while (getline(fin, line)) {
+        size_t pos = line.find('#');
+        if (pos != string::npos) {
+            line.erase(pos);
+        }
+
+        istringstream iss(line);
+        string ip, host;
+        if (!(iss >> ip)) {
+            continue;
+        }
+        boost::system::error_code ec;
+        boost::asio::ip::address address = boost::asio::ip::make_address(ip, ec);
+        if (ec) {
+            continue;
+        }
+        while (iss >> host) {
+            hosts[host].push_back(address);
+        }
+    }
+
+    for (const auto& host : hosts) {
+        pin(host.first, host.second);
+    }
+    return hosts.size();
+}
+
+void DnsCache::clear() {
+    lock_guard<mutex> lock(_mutex);
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        if (!it->second.pinned && !it->second.resolving) {
+            it = _entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DnsCache::setOptions(const DnsOptions& options) {
+    lock_guard<mutex> lock(_mutex);
+    _options = options;
+}
+
+DnsStats DnsCache::Stats() const {
+    lock_guard<mutex> lock(_mutex);
+    return _stats;
+}
+
+}}
@@ -0,0 +1,111 @@
+#ifndef __HTTP_DNS_CACHE_H__
+#define __HTTP_DNS_CACHE_H__
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <boost/asio.hpp>
+
+namespace http {
+namespace httpclient {
+
+typedef std::vector<boost::asio::ip::address> address_list;
+
+/*
+ * 解析结果回调
+ * error 为空表示成功，addresses 按系统解析器返回的顺序排列
+ */
+typedef std::function<void(const std::string& error, const address_list& addresses)> ResolveHandler;
+
+struct DnsOptions {
+    // 解析成功的缓存时间（秒），getaddrinfo 不返回记录的 TTL，统一使用该值
+    int ttl = 300;
+    // 解析失败的缓存时间（秒）
+    int negative_ttl = 30;
+    // 过期前多少秒命中时在后台提前刷新
+    int refresh_ahead = 30;
+    // 最多缓存的 host 数，固定映射不计入淘汰
+    size_t max_entries = 10000;
+};
+
+struct DnsStats {
+    uint64_t hits = 0;
+    uint64_t negative_hits = 0;
+    uint64_t misses = 0;
+    // 后台提前刷新次数
+    uint64_t refreshes = 0;
+};
+
+/*
+ * 进程内 DNS 缓存，线程安全
+ *
+ * - 成功和失败的结果都会缓存
+ * - 快过期的记录被命中时在后台刷新，请求不需要等待
+ * - 同一 host 同时只有一次解析，其它请求等待结果
+ * - 固定映射（pin / load_hosts）不过期，优先于系统解析
+ */
+class DnsCache : public std::enable_shared_from_this<DnsCache> {
+public:
+    DnsCache(boost::asio::io_context& io_context, const DnsOptions& options = DnsOptions());
+
+    /*
+     * 功能 : 异步解析
+     * host 是 ip 地址或命中缓存时直接在调用中回调，否则在 io_context 的线程中回调
+     */
+    void async_resolve(const std::string& host, ResolveHandler handler);
+
+    /*
+     * 功能 : 固定 host 的解析结果，不过期
+     */
+    void pin(const std::string& host, const address_list& addresses);
+
+    /*
+     * 功能 : 从文件加载固定映射，格式同 /etc/hosts，每行 "ip host [host...]"，# 之后为注释
+     * ret  : 加载的 host 数，文件打开失败返回 -1
+     */
+    int load_hosts(const std::string& path);
+
+    /*
+     * 功能 : 清空缓存，保留固定映射
+     */
+    void clear();
+
+    void setOptions(const DnsOptions& options);
+    DnsStats Stats() const;
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct Entry {
+        address_list addresses;
+        std::string error;
+        clock::time_point expires;
+        bool pinned = false;
+        // 正在解析，结果返回前到达的请求在 waiters 中等待
+        bool resolving = false;
+        std::vector<ResolveHandler> waiters;
+    };
+
+    void start_resolve(const std::string& host);
+    void on_resolved(const std::string& host,
+                     const boost::system::error_code& ec,
+                     const boost::asio::ip::tcp::resolver::results_type& results);
+    // 超过 max_entries 时淘汰，需要持有锁
+    void evict(clock::time_point now);
+
+    boost::asio::io_context& _io_context;
+    DnsOptions _options;
+
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, Entry> _entries;
+    DnsStats _stats;
+};
+
+}}
+
+#endif
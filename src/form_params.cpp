@@ -0,0 +1,104 @@
+#include "form_params.h"
+#include "utils.h"
+
+#include <cstring>
+
+namespace http {
+namespace form {
+
+static void assign_decoded(string& out, const char* data, size_t size) {
+    out.assign(data, size);
+    if (size > 0) {
+        out.resize(http::utils::urldecode(&out[0], size, true));
+    }
+}
+
+FormParams::FormParams() : _indexed(false) {
+}
+
+void FormParams::parse(const char* data, size_t size, FormParams& params) {
+    params._indexed = false;
+    const char* end = data + size;
+    while (data < end) {
+        const char* amp = static_cast<const char*>(memchr(data, '&', end - data));
+        if (amp == nullptr) {
+            amp = end;
+        }
+
+        // 跳过空段，例如 a=1&&b=2
+        if (amp != data) {
+            const char* eq = static_cast<const char*>(memchr(data, '=', amp - data));
+            params._items.push_back(Item());
+            Item& item = params._items.back();
+            if (eq == nullptr) {
+                assign_decoded(item.first, data, amp - data);
+            } else {
+                assign_decoded(item.first, data, eq - data);
+                assign_decoded(item.second, eq + 1, amp - eq - 1);
+            }
+        }
+
+        data = amp + 1;
+    }
+}
+
+void FormParams::parse(const string& data, FormParams& params) {
+    parse(data.data(), data.size(), params);
+}
+
+const string* FormParams::get(const string& key) const {
+    if (!_indexed) {
+        _index.clear();
+        _index.reserve(_items.size());
+        for (size_t i = 0; i < _items.size(); ++i) {
+            _index.insert(std::make_pair(_items[i].first, i));
+        }
+        _indexed = true;
+    }
+
+    auto it = _index.find(key);
+    return it == _index.end() ? nullptr : &_items[it->second].second;
+}
+
+vector<string> FormParams::get_all(const string& key) const {
+    vector<string> ret;
+    for (const auto& item : _items) {
+        if (item.first == key) {
+            ret.push_back(item.second);
+        }
+    }
+    return ret;
+}
+
+bool FormParams::has(const string& key) const {
+    return get(key) != nullptr;
+}
+
+void FormParams::add(const string& key, const string& value) {
+    _items.push_back(Item(key, value));
+    _indexed = false;
+}
+
+void FormParams::clear() {
+    _items.clear();
+    _index.clear();
+    _indexed = false;
+}
+
+size_t FormParams::size() const {
+    return _items.size();
+}
+
+bool FormParams::empty() const {
+    return _items.empty();
+}
+
+FormParams::const_iterator FormParams::begin() const {
+    return _items.begin();
+}
+
+FormParams::const_iterator FormParams::end() const {
+    return _items.end();
+}
+
+}}
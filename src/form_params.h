@@ -0,0 +1,65 @@
+#ifndef __HTTP_FORM_PARAMS_H__
+#define __HTTP_FORM_PARAMS_H__
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+using std::string;
+using std::vector;
+using std::unordered_map;
+
+namespace http {
+namespace form {
+
+/*
+ * application/x-www-form-urlencoded 以及 query string 的解析结果
+ * 按出现顺序保存，同名参数保留多个值
+ */
+class FormParams {
+public:
+    typedef std::pair<string, string> Item;
+    typedef vector<Item>::const_iterator const_iterator;
+
+    FormParams();
+
+    /*
+     * 功能 : 单遍解析并原地 urldecode，结果追加到 params
+     * data : key1=val1&key2=val2，没有 '=' 的 key 值为空
+     */
+    static void parse(const char* data, size_t size, FormParams& params);
+    static void parse(const string& data, FormParams& params);
+
+    /*
+     * 返回 key 的第一个值，不存在返回 nullptr
+     * 首次调用时建立 key 索引，之后 O(1) 查找
+     */
+    const string* get(const string& key) const;
+
+    /*
+     * 返回 key 的所有值
+     */
+    vector<string> get_all(const string& key) const;
+
+    bool has(const string& key) const;
+
+    void add(const string& key, const string& value);
+    void clear();
+
+    size_t size() const;
+    bool empty() const;
+    const_iterator begin() const;
+    const_iterator end() const;
+
+private:
+    vector<Item> _items;
+
+    // key -> 第一个值在 _items 中的下标
+    mutable unordered_map<string, size_t> _index;
+    mutable bool _indexed;
+};
+
+}}
+
+#endif
@@ -1,6 +1,9 @@
 #include "http_client.h"
 
 #include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
 
 #include <boost/array.hpp>
 #include <boost/algorithm/string.hpp>
@@ -13,8 +16,6 @@
 #include "request.h"
 #include "qt_webkit_helper.h"
 
-//#define debug
-
 using namespace std;
 using namespace http::utils;
 using boost::asio::ip::tcp;
@@ -23,6 +24,40 @@ using http::request::Request;
 namespace http {
 namespace httpclient {
 
+HttpClient::HttpClient(const PoolOptions& options)
+    : _own_io_context(new boost::asio::io_context()),
+      _io_context(*_own_io_context),
+      _ssl_ctx(boost::asio::ssl::context::tlsv12_client),
+      _pool(options),
+      _dns(std::make_shared<DnsCache>(_io_context)) {
+    init_ssl_context();
+}
+
+HttpClient::HttpClient(boost::asio::io_context& io_context, const PoolOptions& options)
+    : _io_context(io_context),
+      _ssl_ctx(boost::asio::ssl::context::tlsv12_client),
+      _pool(options),
+      _dns(std::make_shared<DnsCache>(_io_context)) {
+    init_ssl_context();
+}
+
+void HttpClient::init_ssl_context() {
+    _ssl_ctx.set_verify_mode(boost::asio::ssl::verify_none);
+    _tls_sessions.attach(_ssl_ctx);
+}
+
+boost::asio::io_context& HttpClient::io_context() {
+    return _io_context;
+}
+
+DnsCache& HttpClient::dns_cache() {
+    return *_dns;
+}
+
+TlsSessionCache& HttpClient::tls_session_cache() {
+    return _tls_sessions;
+}
+
 bool HttpClient::extract_host_port(string url,
                                    string& protocol,
                                    string& host,
@@ -109,175 +144,86 @@ bool HttpClient::parse_response_line(const string& response_line,
     return response.Protocol().substr(0, 5) == "HTTP/";
 }
 
-template<class T>
-void HttpClient::parse_response(boost::asio::io_context& io_context,
-                                T& socket,
-                                Request& request,
-                                Response& response,
-                                int timeout) {
-    try {
-        boost::system::error_code ec;
-
-        // 发送请求
-        socket.async_write_some(boost::asio::buffer(request.to_string()),
-                                [&](const boost::system::error_code& err, std::size_t bytes_transferred){ ec = err; });
-        if (timelimit(io_context, timeout) || ec) {
-            throw ec ? HttpException("write error") : HttpException("write timeout");
-        }
-
-        boost::asio::streambuf response_streambuf;
-        istream response_stream(&response_streambuf);
-
-        // 解析状态行
-        boost::asio::async_read_until(socket,
-                                      response_streambuf,
-                                      "\r\n",
-                                      [&](const boost::system::error_code& err, std::size_t bytes_transferred){ ec = err; });
-        if (timelimit(io_context, timeout) || ec) {
-            throw ec ? HttpException("read error") : HttpException("read timeout");
-        }
-
-        string response_line;
-        getline(response_stream, response_line);
-
-        boost::trim(response_line);
-        if (!parse_response_line(response_line, response)) {
-            throw HttpException("error response_line" + response_line);
-        }
-
-        // 解析响应头
-        boost::asio::async_read_until(socket,
-                                      response_streambuf,
-                                      "\r\n\r\n",
-                                      [&](const boost::system::error_code& err, std::size_t bytes_transferred){ ec = err; });
-        if (timelimit(io_context, timeout) || ec) {
-            throw ec ? HttpException("read error") : HttpException("read timeout");
-        }
-
-        string header_line;
-        while (getline(response_stream, header_line) && header_line != "\r") {
-            size_t pos = header_line.find(":");
-            if (pos == string::npos) { continue; }
-            string key = boost::trim_copy(header_line.substr(0, pos));
-            string value = boost::trim_copy(header_line.substr(pos+1));
-            response.setHeader(key, value);
-        }
+string HttpClient::build_redirection_url(const string& url, Response& response) {
+    string redirect = response.Header("Location");
+    boost::trim(redirect);
 
-        // 拦截 4xx 5xx
-        if (response.StatusCode()[0] == '4' || response.StatusCode()[0] == '5') {
-            throw HttpException("HTTP Error " + response.StatusCode() + ":" + response.StatusDescribe());
-        }
+    // 绝对地址，"://" 出现在路径之前
+    size_t scheme = redirect.find("://");
+    if (scheme != string::npos && scheme < redirect.find_first_of("/?#")) {
+        return redirect;
+    }
 
-        // 接收包体
-        string& response_body = response.setData();
-        // chunked
-        if (response.Header("transfer-encoding") == "chunked") {
-            int cur = 0, len = 0;
-            size_t pos = string::npos;
-
-            boost::asio::streambuf::const_buffers_type cbt = response_streambuf.data();
-            string chunked_body(boost::asio::buffers_begin(cbt), boost::asio::buffers_end(cbt));
-            response_streambuf.consume(chunked_body.size());
-
-            while (true) {
-                while ((pos = chunked_body.find("\r\n", cur)) == string::npos) {
-                    boost::asio::async_read_until(socket,
-                                                  response_streambuf,
-                                                  "\r\n",
-                                                  [&](const boost::system::error_code& err, std::size_t bytes_transferred){ ec = err; });
-                    if (timelimit(io_context, timeout) || ec) {
-                        throw ec ? HttpException("read error") : HttpException("read timeout");
-                    }
-
-                    boost::asio::streambuf::const_buffers_type cbt = response_streambuf.data();
-                    string read_str(boost::asio::buffers_begin(cbt), boost::asio::buffers_end(cbt));
-                    chunked_body += read_str;
-                    response_streambuf.consume(read_str.size());
-                }
-                stringstream ss;
-                ss << hex << chunked_body.substr(cur, pos-cur);
-                ss >> len;
-                cur = cur + (pos-cur) + 2;
-                while (chunked_body.size()-cur < len+2) {
-                    int need_len = len + 2 - chunked_body.size() + cur;
-
-                    boost::asio::async_read(socket,
-                                            response_streambuf,
-                                            boost::asio::transfer_at_least(need_len),
-                                            [&](const boost::system::error_code& err, std::size_t bytes_transferred){ ec = err; });
-                    if (timelimit(io_context, timeout) || ec) {
-                        throw ec ? HttpException("read error") : HttpException("read timeout");
-                    }
-
-                    boost::asio::streambuf::const_buffers_type cbt = response_streambuf.data();
-                    string read_str(boost::asio::buffers_begin(cbt), boost::asio::buffers_end(cbt));
-                    chunked_body += read_str;
-                    response_streambuf.consume(read_str.size());
-                }
-                response_body += chunked_body.substr(cur, len);
-                if (len == 0) {
-                    break;
-                }
-                cur = cur + 2 + len;
-            }
-        // content-length
-        } else if (response.Header("content-length").size() > 0) {
-            int content_length = stoi(response.Header("content-length"));
-            boost::asio::streambuf::const_buffers_type cbt = response_streambuf.data();
-            string first(boost::asio::buffers_begin(cbt), boost::asio::buffers_end(cbt));
-            response_body += first;
-            response_streambuf.consume(first.size());
-
-            boost::asio::async_read(socket,
-                                    response_streambuf,
-                                    boost::asio::transfer_at_least(content_length - first.size()),
-                                    [&](const boost::system::error_code& err, std::size_t bytes_transferred){ ec = err; });
-            if (timelimit(io_context, timeout) || ec) {
-                throw ec ? HttpException("read error") : HttpException("read timeout");
-            }
+    // url 已经通过 extract_host_port 检查
+    size_t authority = url.find("://") + 3;
+    size_t path = url.find_first_of("/?#", authority);
+    if (path == string::npos) {
+        path = url.size();
+    }
+    // 保留端口
+    string origin = url.substr(0, path);
 
-            cbt = response_streambuf.data();
-            string rest(boost::asio::buffers_begin(cbt), boost::asio::buffers_end(cbt));
-            response_body += rest;
-            response_streambuf.consume(rest.size());
-        }
-        //} else {
-            // 空包体
-            // example: http://memory.thethirdmedia.com/
-
-        // 如果是gzip，解压
-        if (boost::to_lower_copy(response.Header("Content-Encoding")) == "gzip") {
-            string data = response.Data();
-            string& decompress_data = response.setData();
-            http::utils::gzip_decompress(data, decompress_data);
-        }
-    } catch (const exception& e) {
-        throw HttpException(e.what());
+    // 省略协议 //host/path
+    if (redirect.compare(0, 2, "//") == 0) {
+        return url.substr(0, authority - 2) + redirect;
+    }
+    if (redirect[0] == '/') {
+        return origin + redirect;
+    }
+    size_t query = url.find_first_of("?#", path);
+    if (query == string::npos) {
+        query = url.size();
     }
+    if (redirect[0] == '?') {
+        return url.substr(0, query) + redirect;
+    }
+    // 相对于当前路径所在的目录
+    string dir = url.substr(path, query - path);
+    dir = dir.substr(0, dir.rfind('/') + 1);
+    if (dir.empty()) {
+        dir = "/";
+    }
+    return origin + dir + redirect;
 }
 
-string HttpClient::build_redirection_url(const string& protocol,
-                                         const string& host,
-                                         Response& response) {
-    string redirect = response.Header("Location");
-    boost::trim(redirect);
-
-    if (redirect.find("http") == string::npos) {
-        if (redirect[0] == '/') {
-            redirect = (protocol + "://" + host) + redirect;
-        } else {
-            redirect = (protocol + "://" + host + "/") + redirect;
-        }
-    }
+void HttpClient::async_request(const string& url,
+                               const string& method,
+                               map<string, string>* headers,
+                               const string& data,
+                               ResponseHandler handler,
+                               int timeout_ms,
+                               int redirect_count) {
+    std::make_shared<ClientSession>(*this, url, method, headers, data, nullptr,
+                                    timeout_ms, redirect_count, handler)->start();
+}
 
-    return redirect;
+std::future<Response> HttpClient::async_request(const string& url,
+                                                const string& method,
+                                                map<string, string>* headers,
+                                                const string& data,
+                                                int timeout_ms) {
+    auto promise = std::make_shared<std::promise<Response>>();
+    async_request(url, method, headers, data,
+                  [promise](const string& error, Response& response) {
+                      if (error.empty()) {
+                          promise->set_value(std::move(response));
+                      } else {
+                          promise->set_exception(std::make_exception_ptr(HttpException(error)));
+                      }
+                  },
+                  timeout_ms);
+    return promise->get_future();
 }
 
-bool HttpClient::timelimit(boost::asio::io_context& io_context,
-                           int timeout) {
-    io_context.restart();
-    io_context.run_for(std::chrono::seconds(timeout));
-    return !io_context.stopped();
+void HttpClient::async_download(const string& url,
+                                const string& method,
+                                map<string, string>* headers,
+                                const string& data,
+                                BodySink sink,
+                                ResponseHandler handler,
+                                int timeout_ms) {
+    std::make_shared<ClientSession>(*this, url, method, headers, data, sink,
+                                    timeout_ms, 0, handler)->start();
 }
 
 Response HttpClient::http_request(const string& url,
@@ -286,166 +232,96 @@ Response HttpClient::http_request(const string& url,
                                   const string& data,
                                   int timeout,
                                   int redirect_count) {
-#ifdef debug
-    if (redirect_count == 0) {
-        cerr << url << endl;
-    }
-    timeval start, end, dot;
-    mark_performance(start);
-#endif
+    return wait_request(url, method, headers, data, nullptr, timeout * 1000, redirect_count);
+}
+
+Response HttpClient::download(const string& url,
+                              const string& method,
+                              map<string, string>* headers,
+                              const string& data,
+                              BodySink sink,
+                              int timeout) {
+    return wait_request(url, method, headers, data, sink, timeout * 1000, 0);
+}
+
+Response HttpClient::wait_request(const string& url,
+                                  const string& method,
+                                  map<string, string>* headers,
+                                  const string& data,
+                                  BodySink sink,
+                                  int timeout_ms,
+                                  int redirect_count) {
     Response response;
-    string protocol, host, port;
+    string error;
+    bool done = false;
+
+    // 外部 io_context 由其它线程驱动
+    if (_own_io_context == nullptr) {
+        std::promise<void> promise;
+        std::make_shared<ClientSession>(*this, url, method, headers, data, sink, timeout_ms, redirect_count,
+                                        [&](const string& err, Response& res) {
+                                            error = err;
+                                            response = std::move(res);
+                                            promise.set_value();
+                                        })->start();
+        promise.get_future().wait();
+        if (!error.empty()) {
+            throw HttpException(error);
+        }
+        return response;
+    }
+
+    std::make_shared<ClientSession>(*this, url, method, headers, data, sink, timeout_ms, redirect_count,
+                                    [&](const string& err, Response& res) {
+                                        error = err;
+                                        response = std::move(res);
+                                        done = true;
+                                    })->start();
 
-    // 解析 协议头、host、port
-    if (!extract_host_port(url, protocol, host, port)) {
-        throw HttpException("not valid url!");
+    run_until(done);
+    if (!error.empty()) {
+        throw HttpException(error);
     }
+    return response;
+}
+
+void HttpClient::async_fetch(const vector<string>& urls,
+                             const BatchOptions& options,
+                             BatchHandler handler,
+                             std::function<void()> done) {
+    std::make_shared<BatchFetcher>(*this, urls, options, handler, done)->start();
+}
 
-    // 支持 http、https 协议
-    if (protocol != "http" && protocol != "https") {
-        throw HttpException("protocol error, only support http and https!");
+void HttpClient::fetch(const vector<string>& urls,
+                       const BatchOptions& options,
+                       BatchHandler handler) {
+    // 外部 io_context 由其它线程驱动
+    if (_own_io_context == nullptr) {
+        std::promise<void> promise;
+        async_fetch(urls, options, handler, [&promise]() { promise.set_value(); });
+        promise.get_future().wait();
+        return;
     }
 
-    // 设置请求报文
-    Request request;
-    build_request_message(url, method, host, data, headers, request);
-
-    try {
-        boost::asio::io_context io_context;
-#ifdef debug
-        mark_performance(dot);
-#endif
-        // 根据 hostname 查询 ip 地址
-        tcp::resolver resolver(io_context);
-        boost::system::error_code ec;
-        tcp::resolver::results_type endpoints = resolver.resolve(host, protocol, ec);
-        if (ec) { throw HttpException(ec.message()); }
-
-        boost::asio::ip::tcp::endpoint endpoint;
-        for (auto it = endpoints.begin(); it != endpoints.end(); ++it) {
-            boost::asio::ip::tcp::endpoint ep = *it;
-            if (ep.port() == stoi(port)) {
-                endpoint = ep;
-                break;
-            }
-        }
-#ifdef debug
-        mark_performance(end);
-        if (redirect_count == 0) {
-            cerr << "resolve cost " << performance(dot, end) << "ms" << endl;
-        }
-#endif
-        // 如果没有查询到有效 ip 地址，直接写入请求的 ip 地址以及 port
-        if (endpoint.address().to_string() == "0.0.0.0") {
-            boost::asio::ip::address ad = boost::asio::ip::address::from_string(host);
-            endpoint = boost::asio::ip::tcp::endpoint(ad, stoi(port));
-        }
+    bool done = false;
+    async_fetch(urls, options, handler, [&done]() { done = true; });
+    run_until(done);
+}
 
-        // https
-        if (protocol == "https") {
-#ifdef debug
-            mark_performance(dot);
-#endif
-            boost::asio::ssl::context ctx(boost::asio::ssl::context::tlsv12_client);
-            ctx.set_verify_mode(boost::asio::ssl::verify_none);
-            boost::asio::ssl::stream<tcp::socket> socket{io_context, ctx};
-
-            // Set SNI Hostname (many hosts need this to handshake successfully)
-            // https://github.com/boostorg/beast/blob/develop/example/http/client/sync-ssl/http_client_sync_ssl.cpp
-            if(!SSL_set_tlsext_host_name(socket.native_handle(), host.c_str())) {
-                boost::system::error_code ec{static_cast<int>(::ERR_get_error()), boost::asio::error::get_ssl_category()};
-                    throw boost::system::system_error{ec};
-            }
+void HttpClient::run_until(const bool& done) {
+    // 只执行到本次请求结束，被取消的操作留给下次请求或析构时处理
+    _io_context.restart();
+    while (!done && _io_context.run_one()) {}
 
-            boost::system::error_code ec;
-            socket.lowest_layer().async_connect(endpoint, [&](const boost::system::error_code& error){ ec = error; });
-            if (timelimit(io_context, timeout) || ec) {
-                socket.lowest_layer().close();
-                throw ec ? HttpException("connect error") : HttpException("connect timeout");
-            }
-#ifdef debug
-            mark_performance(end);
-            if (redirect_count == 0) {
-                cerr << "connect cost " << performance(dot, end) << "ms" << endl;
-            }
-            mark_performance(dot);
-#endif
-            socket.handshake(boost::asio::ssl::stream_base::client);
-            try {
-                parse_response(io_context, socket, request, response, timeout);
-            } catch (const HttpException& ex) {
-                socket.lowest_layer().close();
-                throw ex;
-            }
-#ifdef debug
-            mark_performance(end);
-            if (redirect_count == 0) {
-                cerr << "parse response cost " << performance(dot, end) << "ms" << endl;
-            }
-#endif
-            socket.lowest_layer().close();
-        // http
-        } else if (protocol == "http") {
-#ifdef debug
-            mark_performance(dot);
-#endif
-            tcp::socket socket(io_context);
-            boost::system::error_code ec;
-            socket.async_connect(endpoint, [&](const boost::system::error_code& error){ ec = error; });
-            if (timelimit(io_context, timeout) || ec) {
-                socket.close();
-                throw ec ? HttpException("connect error") : HttpException("connect timeout");
-            }
-#ifdef debug
-            mark_performance(end);
-            if (redirect_count == 0) {
-                cerr << "connect cost " << performance(dot, end) << "ms" << endl;
-            }
-            mark_performance(dot);
-#endif
-            try {
-                parse_response(io_context, socket, request, response, timeout);
-            } catch (const HttpException& ex) {
-                socket.close();
-                throw ex;
-            }
-#ifdef debug
-            mark_performance(end);
-            if (redirect_count == 0) {
-                cerr << "parse response cost " << performance(dot, end) << "ms" << endl;
-            }
-#endif
-            socket.close();
-        }
-#ifdef debug
-        mark_performance(dot);
-#endif
-        // 3xx Redirection
-        if (redirect_count <= 5) {
-            string code = response.StatusCode();
-            if (code == "301" || code == "302") {
-                string lower_method = boost::to_lower_copy(method);
-                if (lower_method == "get" || lower_method == "head") {
-                    string re_url = build_redirection_url(protocol, host, response);
-                    response = http_request(re_url, method, headers, data, timeout, redirect_count+1);
-                }
-            }
-        }
-#ifdef debug
-        mark_performance(end);
-        if (redirect_count == 0) {
-            cerr << "redirect cost " << performance(dot, end) << "ms" << endl;
-            cerr << "all cost " << performance(start, end) << "ms" << endl;
-        }
-#endif
-        return response;
-    } catch (const HttpException& e) {
-        throw e;
-    } catch (const exception& e) {
-        throw e;
+    if (!done) {
+        throw HttpException("request aborted");
     }
 }
 
+void HttpClient::setRenderPool(std::shared_ptr<http::render::RenderPool> pool) {
+    _render_pool = pool;
+}
+
 Response HttpClient::http_request_render(const string& url,
                                          const string& method,
                                          map<string, string>* headers,
@@ -454,29 +330,59 @@ Response HttpClient::http_request_render(const string& url,
                                          int redirect_count,
                                          int argc,
                                          char* argv[]) {
+    http::render::CompletionOptions completion;
+    completion.budget_ms = timeout * 1000;
+    return http_request_render(url, completion, argc, argv);
+}
+
+Response HttpClient::http_request_render(const string& url,
+                                         const http::render::CompletionOptions& completion,
+                                         int argc,
+                                         char* argv[]) {
+    if (_render_pool != nullptr) {
+        return _render_pool->render(url, completion);
+    }
+
     qputenv("QT_QPA_PLATFORM", "offscreen");
 
 	QApplication app(argc, argv);
 
     Response response;
-	http::qt_helper::WebPage w(app, response);
-	w.settings()->setAttribute(QWebSettings::PrivateBrowsingEnabled, true);
-	w.settings()->setAttribute(QWebSettings::PluginsEnabled, false);
-	w.settings()->setAttribute(QWebSettings::JavaEnabled, false);
-	w.settings()->setAttribute(QWebSettings::AutoLoadImages, false);
-	w.settings()->setAttribute(QWebSettings::DnsPrefetchEnabled, true);
-	w.settings()->setAttribute(QWebSettings::DeveloperExtrasEnabled, true);
-
-    QTimer t;
-    QObject::connect(&t, &QTimer::timeout, [&app](){ app.quit(); });
-    t.setSingleShot(true);
-    t.start(timeout * 1000);
+	http::qt_helper::WebPage w;
+    http::qt_helper::apply_default_settings(w.settings());
 
     QUrl q_url(url.c_str());
-	w.load(q_url.toString());
+	w.load(q_url.toString(), completion, response, [&app](bool){ app.quit(); });
 	app.exec();
 
     return response;
 }
 
+BodySink fd_sink(int fd) {
+    return [fd](const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw HttpException(string("write error: ") + strerror(errno));
+            }
+            data += n;
+            size -= n;
+        }
+    };
+}
+
+BodySink buffer_sink(char* buffer, size_t capacity, size_t* size) {
+    *size = 0;
+    return [buffer, capacity, size](const char* data, size_t n) {
+        if (n > capacity - *size) {
+            throw HttpException("buffer full");
+        }
+        memcpy(buffer + *size, data, n);
+        *size += n;
+    };
+}
+
 }}
@@ -8,12 +8,21 @@
 
 #include <iostream>
 #include <map>
+#include <future>
+#include <memory>
 #include "response.h"
 #include "request.h"
+#include "connection_pool.h"
+#include "client_session.h"
+#include "batch_fetcher.h"
+#include "dns_cache.h"
+#include "tls_session_cache.h"
+#include "render_pool.h"
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
 using http::response::Response;
+using http::response::TimingInfo;
 using http::request::Request;
 
 namespace http {
@@ -23,8 +32,26 @@ struct Socket {
     boost::asio::ip::tcp::socket socket;
 };
 
+/*
+ * 同一 host 的请求复用 keep-alive 连接（包括 TLS 连接）
+ *
+ * 异步接口：async_request 立即返回，结果在 io_context 中回调，
+ * 使用外部 io_context 时可以由多个线程同时 run，一个 HttpClient 可以同时发起大量请求
+ *
+ * 同步接口：http_request 基于异步接口实现
+ * 使用内部 io_context 时在调用线程中驱动，一个 HttpClient 只能在一个线程中使用；
+ * 使用外部 io_context 时等待其它线程完成请求，不能在 io_context 的线程中调用
+ *
+ * 自动跟随 301/302/303/307/308 跳转，同一站点时复用连接，经过的跳转见 Response::Redirects()
+ *
+ * HttpClient 需要比它发起的所有请求存活更久
+ */
 class HttpClient {
 public:
+    explicit HttpClient(const PoolOptions& options = PoolOptions());
+    explicit HttpClient(boost::asio::io_context& io_context,
+                        const PoolOptions& options = PoolOptions());
+
     /*
      * func : http客户端请求，支持https
      * 
@@ -32,7 +59,7 @@ public:
      * method  : 请求方法
      * headers : 请求头
      * data    : 请求体
-     * timeout : 超时
+     * timeout : 超时（秒），整个请求的截止时间
      *
      * Response : 响应报文信息
      *
@@ -44,6 +71,95 @@ public:
                           int timeout = 2,
                           int redirect_count = 0);
 
+    /*
+     * func : 异步http客户端请求，支持https，线程安全
+     *
+     * handler    : 请求结束时回调，error 为空表示成功
+     * timeout_ms : 超时（毫秒），整个请求的截止时间
+     *
+     * headers 在调用返回前已经复制，不需要保持有效
+     */
+    void async_request(const std::string& url,
+                       const std::string& method,
+                       std::map<string, string>* headers,
+                       const std::string& data,
+                       ResponseHandler handler,
+                       int timeout_ms = 2000,
+                       int redirect_count = 0);
+
+    /*
+     * func : 异步http客户端请求，失败时 future 抛出 HttpException
+     */
+    std::future<Response> async_request(const std::string& url,
+                                        const std::string& method,
+                                        std::map<string, string>* headers,
+                                        const std::string& data,
+                                        int timeout_ms = 2000);
+
+    /*
+     * func : 流式下载，线程安全
+     *
+     * sink : 包体（gzip 已解压）按到达顺序分块传入，内存占用与包体大小无关
+     *        sink 抛出异常时请求以 "body error: ..." 结束
+     *
+     * handler 中的 Response 只有响应头和耗时，Data() 为空
+     */
+    void async_download(const std::string& url,
+                        const std::string& method,
+                        std::map<string, string>* headers,
+                        const std::string& data,
+                        http::common::BodySink sink,
+                        ResponseHandler handler,
+                        int timeout_ms = 2000);
+
+    /*
+     * func : 流式下载，同步接口，线程要求同 http_request
+     */
+    Response download(const std::string& url,
+                      const std::string& method,
+                      std::map<string, string>* headers,
+                      const std::string& data,
+                      http::common::BodySink sink,
+                      int timeout = 2);
+
+    /*
+     * func : 批量抓取，线程安全
+     *
+     * urls    : 请求url列表
+     * options : 全局并发数、host 并发数、host 请求间隔等
+     * handler : 每个请求结束时按完成顺序回调，回调串行执行，
+     *           耗时见 Response::Timing()
+     * done    : 全部请求结束后回调
+     */
+    void async_fetch(const std::vector<std::string>& urls,
+                     const BatchOptions& options,
+                     BatchHandler handler,
+                     std::function<void()> done = nullptr);
+
+    /*
+     * func : 批量抓取，全部请求结束后返回，回调方式同 async_fetch
+     */
+    void fetch(const std::vector<std::string>& urls,
+               const BatchOptions& options,
+               BatchHandler handler);
+
+    boost::asio::io_context& io_context();
+
+    /*
+     * DNS 缓存，可以设置参数、加载固定映射
+     */
+    DnsCache& dns_cache();
+
+    /*
+     * TLS 会话缓存，Stats() 为完整握手和简化握手的次数
+     */
+    TlsSessionCache& tls_session_cache();
+
+    /*
+     * 设置后 http_request_render 由渲染进程池完成，可以在多个线程中同时调用
+     */
+    void setRenderPool(std::shared_ptr<http::render::RenderPool> pool);
+
     /*
      * func : http客户端请求，支持https、页面渲染
      * 
@@ -64,7 +180,31 @@ public:
                                  int redirect_count = 0,
                                  int argc = 1,
                                  char* argv[] = nullptr);
+
+    /*
+     * func : 渲染页面
+     *
+     * completion : 结束条件（network idle、DOM stable、js 条件）和毫秒级的时间预算
+     *
+     * Response : Data() 为渲染后的 html，Completion() 为结束渲染的条件，
+     *            Timeout 表示超过预算，内容可能不完整
+     */
+    Response http_request_render(const std::string& url,
+                                 const http::render::CompletionOptions& completion,
+                                 int argc = 1,
+                                 char* argv[] = nullptr);
 private:
+    /*
+     * 同步请求：等待异步请求结束，失败时抛出 HttpException
+     */
+    Response wait_request(const std::string& url,
+                          const std::string& method,
+                          std::map<string, string>* headers,
+                          const std::string& data,
+                          http::common::BodySink sink,
+                          int timeout_ms,
+                          int redirect_count);
+
     /*
      * func : 从url中提取host
      */
@@ -82,32 +222,47 @@ private:
                                std::map<std::string,
                                std::string>* headers,
                                Request& request);
-    /*
-     * 处理响应报文
-     */
-    template<class T>
-    void parse_response(boost::asio::io_context& io_context,
-                        T& socket,
-                        Request& request,
-                        Response& response,
-                        int timeout);
     /*
      * 解析响应报文状态行
      */
     bool parse_response_line(const string& response_line, Response& response);
 
     /*
-     * 处理http_code 3xx
+     * 处理http_code 3xx，按当前 url 解析 Location 中的相对地址
      */
-    string build_redirection_url(const string& protocol,
-                                 const string& host,
-                                 Response& response);
+    string build_redirection_url(const string& url, Response& response);
+
+    void init_ssl_context();
+
     /*
-     * 异步操作超时限制
+     * 驱动内部 io_context 直到 done 为 true，使用外部 io_context 时不能调用
      */
-    bool timelimit(boost::asio::io_context& io_context, int timeout);
+    void run_until(const bool& done);
+
+    friend class ClientSession;
+    friend class BatchFetcher;
+
+    // 不使用外部 io_context 时由 HttpClient 持有
+    std::unique_ptr<boost::asio::io_context> _own_io_context;
+    boost::asio::io_context& _io_context;
+    // 所有 https 连接共用，需要在连接池之前构造、之后析构
+    boost::asio::ssl::context _ssl_ctx;
+    TlsSessionCache _tls_sessions;
+    ConnectionPool _pool;
+    std::shared_ptr<DnsCache> _dns;
+    std::shared_ptr<http::render::RenderPool> _render_pool;
 };
 
+/*
+ * 写入文件描述符，不关闭 fd，写入失败时抛出 HttpException
+ */
+http::common::BodySink fd_sink(int fd);
+
+/*
+ * 写入固定大小的缓冲区，*size 为已写入的字节数，超出 capacity 时抛出 HttpException
+ */
+http::common::BodySink buffer_sink(char* buffer, size_t capacity, size_t* size);
+
 }}
 
 #endif
@@ -2,6 +2,7 @@
 #define __HTTP_COMMON_H__
 
 #include <cstring>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <vector>
@@ -14,6 +15,7 @@ namespace http {
 namespace common {
 
 static const string CRLF = "\r\n";
+static const string CRLFCRLF = "\r\n\r\n";
 static const string SPACE = " ";
 
 static const vector<string> HEADERS = {
@@ -31,6 +33,9 @@ static const vector<string> HEADERS = {
 
 static const string RESPONSE_SUCCESS_STATUS_LINE = "HTTP/1.1 200 OK\r\n";
 
+// 包体输出，数据按到达顺序分段回调
+typedef std::function<void(const char* data, size_t size)> BodySink;
+
 struct HttpException : public std::exception {
     string _message;
 
@@ -5,6 +5,7 @@
 
 #include <boost/algorithm/string.hpp>
 #include "http_server.h"
+#include "access_log.h"
 #include "request.h"
 #include "log.h"
 #include "utils.h"
@@ -16,13 +17,34 @@ using namespace http::log;
 using namespace http::utils;
 using namespace http::common;
 using boost::asio::ip::tcp;
+using http::metrics::Stage;
 
 namespace http {
 namespace httpserver {
 
+// 管理端口只处理很短的请求
+static const size_t ADMIN_BUFFER_SIZE = 4096;
+// 管理端口 accept 出错后重试的间隔
+static const std::chrono::milliseconds ADMIN_ACCEPT_RETRY(100);
+
+static uint64_t elapsed_us(std::chrono::steady_clock::time_point begin,
+                           std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+}
+
+// 状态行 "HTTP/1.1 200 ..."，无法识别时返回 0
+static int response_status(const string& response) {
+    if (response.size() >= 12 && isdigit(response[9]) && isdigit(response[10]) && isdigit(response[11])) {
+        return (response[9] - '0') * 100 + (response[10] - '0') * 10 + (response[11] - '0');
+    }
+    return 0;
+}
+
 HttpServer::HttpServer(int buffer_size, int port) : 
                                                 ACCEPTOR(SERVICE),
-                                                buffer_size(buffer_size) {
+                                                buffer_size(buffer_size),
+                                                _access_log(AccessLogFormat::Text),
+                                                _signals(SERVICE) {
     boost::asio::ip::tcp::endpoint ep(boost::asio::ip::tcp::v4(), port);
     ACCEPTOR.open(ep.protocol());
     ACCEPTOR.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
@@ -30,8 +52,130 @@ HttpServer::HttpServer(int buffer_size, int port) :
     ACCEPTOR.listen();
 }
 
+void HttpServer::setAccessLog(AccessLogFormat format) {
+    _access_log = format;
+}
+
+void HttpServer::setConfFile(const string& file_path) {
+    _conf_file = file_path;
+    reload_conf();
+}
+
+void HttpServer::reload_conf() {
+    map<string, string> conf;
+    if (!read_conf(_conf_file, conf)) {
+        LOGOUT(ERROR, "read conf % fail", _conf_file);
+        return;
+    }
+
+    if (conf.count("log_level")) {
+        LOG_LEVEL level;
+        if (parse_log_level(conf["log_level"], level)) {
+            set_log_level(level);
+        } else {
+            LOGOUT(ERROR, "unknown log_level %", conf["log_level"]);
+        }
+    }
+    try {
+        uint64_t rotate_bytes = conf.count("log_rotate_bytes") ? stoull(conf["log_rotate_bytes"]) : 0;
+        int rotate_seconds = conf.count("log_rotate_seconds") ? stoi(conf["log_rotate_seconds"]) : 0;
+        AsyncLogger::instance().setRotation(rotate_bytes, rotate_seconds);
+    } catch (const std::exception& e) {
+        LOGOUT(ERROR, "bad log rotation conf: %", e.what());
+    }
+}
+
+void HttpServer::wait_signal() {
+    _signals.async_wait([this](const e_code& err, int) {
+        if (err) {
+            return;
+        }
+        reload_conf();
+        AsyncLogger::instance().reopen();
+        LOGOUT(INFO, "reload conf %", _conf_file);
+        wait_signal();
+    });
+}
+
+void HttpServer::setAdminPort(int port) {
+    tcp::endpoint ep(tcp::v4(), port);
+    _admin_acceptor.reset(new tcp::acceptor(SERVICE));
+    _admin_acceptor->open(ep.protocol());
+    _admin_acceptor->set_option(tcp::acceptor::reuse_address(true));
+    _admin_acceptor->bind(ep);
+    _admin_acceptor->listen();
+}
+
+const ServerMetrics& HttpServer::Metrics() const {
+    return _metrics;
+}
+
+void HttpServer::admin_accept() {
+    shared_ptr<Connection> conn(new Connection(SERVICE, ADMIN_BUFFER_SIZE));
+    _admin_acceptor->async_accept(*conn->sock, [this, conn](const e_code& err) {
+        // acceptor 已关闭
+        if (err == boost::asio::error::operation_aborted) {
+            return;
+        }
+        // 其它错误（例如文件描述符用尽）稍后重新 accept，立即重试会空转
+        if (err) {
+            LOGOUT(ERROR, "admin accept error: %", err.message());
+            auto timer = std::make_shared<boost::asio::steady_timer>(SERVICE, ADMIN_ACCEPT_RETRY);
+            timer->async_wait([this, timer](const e_code&) { admin_accept(); });
+            return;
+        }
+        admin_read(conn);
+        admin_accept();
+    });
+}
+
+void HttpServer::admin_read(shared_ptr<Connection> conn) {
+    conn->sock->async_read_some(buffer(conn->request_buffer + conn->read_size, ADMIN_BUFFER_SIZE - conn->read_size),
+                                [this, conn](const e_code& err, std::size_t bytes_transferred) {
+        if (err) {
+            return;
+        }
+        conn->read_size += bytes_transferred;
+        char* end = conn->request_buffer + conn->read_size;
+        char* pos = std::search(conn->request_buffer, end, CRLFCRLF.begin(), CRLFCRLF.end());
+        if (pos == end) {
+            if (conn->read_size == ADMIN_BUFFER_SIZE) {
+                conn->sock->close();
+            } else {
+                admin_read(conn);
+            }
+            return;
+        }
+
+        conn->request->extract_request(string(conn->request_buffer, pos - conn->request_buffer + CRLFCRLF.size()));
+        string body;
+        string& ret = conn->response_buffer;
+        if (conn->request->Url().empty()) {
+            body = "400";
+            ret = "HTTP/1.1 400 Bad Request\r\nContent-Type: text/plain\r\n";
+        } else if (conn->request->Url() == "/metrics") {
+            _metrics.write_prometheus(body);
+            ret = RESPONSE_SUCCESS_STATUS_LINE + "Content-Type: text/plain; version=0.0.4\r\n";
+        } else {
+            body = "404";
+            ret = "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n";
+        }
+        ret += "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        async_write(*conn->sock, buffer(conn->response_buffer), [conn](const e_code&, std::size_t) {
+            conn->sock->close();
+        });
+    });
+}
+
 void HttpServer::run(){    
     LOGOUT(INFO, "%", "start server...");
+    if (!_conf_file.empty()) {
+        _signals.add(SIGHUP);
+        wait_signal();
+    }
+    if (_admin_acceptor != nullptr) {
+        admin_accept();
+    }
     accept();
     SERVICE.run();
 }
@@ -47,71 +191,172 @@ void HttpServer::accept_handle(shared_ptr<Connection> conn, const e_code& err){
         return;
     }
 
-    async_read(*conn->sock, 
-               buffer(conn->request_buffer, buffer_size), 
-               bind(&HttpServer::read_complete, this, conn, _1, _2),
-               bind(&HttpServer::read_handle, this, conn, _1, _2));
+    conn->accept_time = std::chrono::steady_clock::now();
+    conn->accept_timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    conn->metrics = &_metrics;
+    _metrics.connection_opened();
+    read(conn);
 
     accept();
 }
 
-// 逐个字节的读
-size_t HttpServer::read_complete(shared_ptr<Connection> conn, const e_code& err, size_t size){
-    if (err) {
-        LOGOUT(FATAL, "%", "receive request error");
-        return 0;
-    }
+void HttpServer::read(shared_ptr<Connection> conn) {
+    conn->sock->async_read_some(buffer(conn->request_buffer + conn->read_size,
+                                       buffer_size - conn->read_size),
+                                bind(&HttpServer::read_handle, this, conn, _1, _2));
+}
+
+void HttpServer::consume(shared_ptr<Connection> conn, size_t size) {
+    memmove(conn->request_buffer, conn->request_buffer + size, conn->read_size - size);
+    conn->read_size -= size;
+    conn->header_scanned = 0;
+}
+
+// 请求头需要完整的放在 request_buffer 中，请求体边读边交给 body_sink
+READ_STATUS HttpServer::read_complete(shared_ptr<Connection> conn){
+    char* buf = conn->request_buffer;
 
     // 读取完整的 请求行 + 请求头
-    string request(conn->request_buffer, size);
-    size_t pos = request.find(CRLF + CRLF);
-    if (pos == string::npos) {
-        return true;
+    if (!conn->header_complete) {
+        char* end = buf + conn->read_size;
+        char* pos = std::search(buf + conn->header_scanned, end, CRLFCRLF.begin(), CRLFCRLF.end());
+        if (pos == end) {
+            conn->header_scanned = conn->read_size < 3 ? 0 : conn->read_size - 3;
+            // 请求头超过 buffer 大小
+            return conn->read_size == size_t(buffer_size) ? READ_ERROR : READ_MORE;
+        }
+
+        size_t header_size = pos - buf + CRLFCRLF.size();
+        conn->request->extract_request(string(buf, header_size));
+        conn->header_complete = true;
+        if (conn->request->Url().empty()) {
+            return READ_ERROR;
+        }
+
+        // 根据 transfer-encoding、content-length 决定是否继续读取 请求体
+        const string& content_length = conn->request->Header("content-length");
+        if (boost::algorithm::to_lower_copy(conn->request->Header("transfer-encoding")).find("chunked") != string::npos) {
+            conn->body_mode = BODY_CHUNKED;
+        } else if (!content_length.empty()) {
+            if (content_length.find_first_not_of("0123456789") != string::npos) {
+                return READ_ERROR;
+            }
+            conn->body_mode = BODY_LENGTH;
+            conn->body_remaining = strtoull(content_length.c_str(), nullptr, 10);
+        }
+
+        if (conn->body_mode != BODY_NONE) {
+            conn->body_sink = body_sink(conn);
+        }
+        consume(conn, header_size);
     }
 
-    // 根据 method 类型决定是否继续读取 请求体
-    if (conn->request->Method().empty()){
-        conn->request->extract_request(request);
-        if (boost::algorithm::to_lower_copy(conn->request->Method()) == "get") {
-            return false;
-        } else if (boost::algorithm::to_lower_copy(conn->request->Method()) == "post") {
-            return stoi(conn->request->Header("content-length")) != 0;
+    if (conn->body_mode == BODY_LENGTH) {
+        size_t size = size_t(std::min<uint64_t>(conn->read_size, conn->body_remaining));
+        if (size > 0 && conn->body_sink) {
+            conn->body_sink(buf, size);
         }
-    } else {
-        string body = request.substr(pos + 4);    
-        int content_length = stoi(conn->request->Header("content-length"));
-        if (int(body.size()) == content_length) {
-            conn->request->setData(body);
-            return false;
+        conn->body_remaining -= size;
+        consume(conn, size);
+        return conn->body_remaining == 0 ? READ_DONE : READ_MORE;
+    } else if (conn->body_mode == BODY_CHUNKED) {
+        consume(conn, conn->chunked.feed(buf, conn->read_size, conn->body_sink));
+        if (conn->chunked.error()) {
+            return READ_ERROR;
         }
+        return conn->chunked.done() ? READ_DONE : READ_MORE;
     }
 
-    return true;
+    return READ_DONE;
 }
 
 void HttpServer::read_handle(shared_ptr<Connection> conn,
                             const e_code& err,
                             std::size_t bytes_transferred){
-    boost::asio::ip::tcp::endpoint endpoint = conn->sock->remote_endpoint();
     if (err){
         LOGOUT(ERROR, "%", "read handel error");
         return;
     }
 
-    LOGOUT(INFO, "% request % ...", conn->request->Header("host"), conn->request->Url());
+    if (conn->bytes_in == 0) {
+        conn->first_byte_time = std::chrono::steady_clock::now();
+        _metrics.record_stage(Stage::AcceptToFirstByte, elapsed_us(conn->accept_time, conn->first_byte_time));
+    }
+    conn->read_size += bytes_transferred;
+    conn->bytes_in += bytes_transferred;
+    _metrics.add_bytes_in(bytes_transferred);
+    READ_STATUS status = read_complete(conn);
+    if (status == READ_ERROR) {
+        LOGOUT(ERROR, "%", "bad request");
+        conn->sock->close();
+        return;
+    } else if (status == READ_MORE) {
+        read(conn);
+        return;
+    }
+
+    conn->parsed_time = std::chrono::steady_clock::now();
+    _metrics.record_stage(Stage::Parse, elapsed_us(conn->first_byte_time, conn->parsed_time));
+
+    if (_access_log == AccessLogFormat::Text) {
+        LOGOUT(INFO, "% request % ...", conn->request->Header("host"), conn->request->Url());
+    }
 
     router(conn);
 }
 
+BodySink HttpServer::body_sink(shared_ptr<Connection> conn) {
+    string& data = conn->request->setData();
+    data.clear();
+    if (conn->body_mode == BODY_LENGTH && conn->body_remaining <= uint64_t(buffer_size)) {
+        data.reserve(size_t(conn->body_remaining));
+    }
+    return [&data](const char* d, size_t size){ data.append(d, size); };
+}
+
 void HttpServer::write_handle(shared_ptr<Connection> conn,
                              const e_code& err,
                              std::size_t bytes_transferred){
     if (err){
         LOGOUT(ERROR, "%", "write handel error");
+    } else {
+        _metrics.record_stage(Stage::Write, elapsed_us(conn->handled_time, std::chrono::steady_clock::now()));
+        _metrics.record_response(response_status(conn->response_buffer), bytes_transferred);
+        if (_access_log == AccessLogFormat::Binary) {
+            log_access(conn, bytes_transferred);
+        }
     }
     conn->sock->close();
 }
 
+void HttpServer::log_access(shared_ptr<Connection> conn, std::size_t bytes_out) {
+    http::access_log::AccessRecord record;
+    memset(&record, 0, sizeof(record));
+    record.method = http::access_log::method_from_string(conn->request->Method());
+    record.status = response_status(conn->response_buffer);
+    record.latency_us = elapsed_us(conn->accept_time, std::chrono::steady_clock::now());
+    record.timestamp_us = conn->accept_timestamp_us;
+    record.bytes_in = conn->bytes_in;
+    record.bytes_out = bytes_out;
+
+    e_code ec;
+    tcp::endpoint peer = conn->sock->remote_endpoint(ec);
+    if (!ec && peer.address().is_v4()) {
+        auto bytes = peer.address().to_v4().to_bytes();
+        memcpy(record.peer, bytes.data(), bytes.size());
+        record.peer_family = 4;
+        record.peer_port = peer.port();
+    } else if (!ec) {
+        auto bytes = peer.address().to_v6().to_bytes();
+        memcpy(record.peer, bytes.data(), bytes.size());
+        record.peer_family = 6;
+        record.peer_port = peer.port();
+    }
+
+    http::access_log::write(record, conn->request->Url());
+}
+
 /*
 void HttpServer::response_chunked(shared_ptr<Connection> conn, const string& message) {
     string message_ = message;
@@ -137,6 +382,10 @@ void HttpServer::response_chunked(shared_ptr<Connection> conn, const string& mes
 */
 
 void HttpServer::response(shared_ptr<Connection> conn, const string& message) {
+    // 压缩和组装响应计入 Write 阶段
+    conn->handled_time = std::chrono::steady_clock::now();
+    _metrics.record_stage(Stage::Handler, elapsed_us(conn->parsed_time, conn->handled_time));
+
     string url = conn->request->Url();
     string& ret = conn->response_buffer;
     ret += RESPONSE_SUCCESS_STATUS_LINE; 
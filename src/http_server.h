@@ -9,7 +9,10 @@
 #include "request.h"
 #include "http_common.h"
 #include "mime_types.h"
+#include "chunked_decoder.h"
+#include "server_metrics.h"
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <set>
@@ -28,6 +31,8 @@ using namespace http::common;
 using namespace http::mime_types;
 
 using http::request::Request;
+using http::chunked::ChunkedDecoder;
+using http::metrics::ServerMetrics;
 using boost::asio::ip::tcp;
 
 namespace http{  
@@ -36,11 +41,41 @@ namespace httpserver{
 typedef shared_ptr<boost::asio::ip::tcp::socket> shared_socket;
 typedef boost::system::error_code e_code;
 
+// 请求体的传输方式
+enum BODY_MODE {
+    BODY_NONE = 0,
+    BODY_LENGTH,    // content-length
+    BODY_CHUNKED    // transfer-encoding: chunked
+};
+
+// 访问日志格式
+enum class AccessLogFormat {
+    // INFO 日志中的一行文本
+    Text,
+    // 二进制记录，见 access_log.h
+    Binary
+};
+
+// 请求读取状态
+enum READ_STATUS {
+    READ_ERROR = -1,
+    READ_MORE,
+    READ_DONE
+};
+
 struct Connection {
     Connection(boost::asio::io_service& service, size_t buffer_size) {
         request = new Request;
         request_buffer = new char[buffer_size];
         sock = new tcp::socket(service);
+        read_size = 0;
+        header_scanned = 0;
+        header_complete = false;
+        body_mode = BODY_NONE;
+        body_remaining = 0;
+        accept_timestamp_us = 0;
+        bytes_in = 0;
+        metrics = nullptr;
     }
 
     char* request_buffer;
@@ -48,8 +83,32 @@ struct Connection {
     Request* request;
     tcp::socket* sock;
 
+    // request_buffer 中尚未处理的字节数
+    size_t read_size;
+    // 已经查找过 CRLFCRLF 的位置
+    size_t header_scanned;
+    bool header_complete;
+
+    BODY_MODE body_mode;
+    uint64_t body_remaining;
+    ChunkedDecoder chunked;
+    BodySink body_sink;
+
+    // 访问日志、统计
+    std::chrono::steady_clock::time_point accept_time;
+    std::chrono::steady_clock::time_point first_byte_time;
+    std::chrono::steady_clock::time_point parsed_time;
+    std::chrono::steady_clock::time_point handled_time;
+    uint64_t accept_timestamp_us;
+    uint64_t bytes_in;
+    // accept 成功后设置，关闭时计数
+    ServerMetrics* metrics;
+
     ~Connection() {
-        delete request_buffer;
+        if (metrics != nullptr) {
+            metrics->connection_closed();
+        }
+        delete[] request_buffer;
         delete request;
         delete sock;
     }
@@ -70,10 +129,41 @@ public:
     // 加载配置文件
     static bool read_conf(const string& file_path, map<string, string>& g_conf);
 
+    // 在 run 之前设置，默认 Text
+    void setAccessLog(AccessLogFormat format);
+
+    /*
+     * 从配置文件读取可以在运行时修改的配置，收到 SIGHUP 时重新读取并重新打开日志文件
+     *   log_level          TRACE、DEBUG、INFO、WARN、ERROR、FATAL
+     *   log_rotate_bytes   日志文件超过这个大小时轮转，0 表示不按大小轮转
+     *   log_rotate_seconds 日志文件打开超过这个时间时轮转，0 表示不按时间轮转
+     * 在 run 之前设置
+     */
+    void setConfFile(const string& file_path);
+
+    /*
+     * 在 port 上提供 GET /metrics，Prometheus 文本格式
+     * 在 run 之前设置，不设置时不监听
+     */
+    void setAdminPort(int port);
+
+    const ServerMetrics& Metrics() const;
+
 private:
     void accept();
 
     const int buffer_size;
+    AccessLogFormat _access_log;
+    string _conf_file;
+    boost::asio::signal_set _signals;
+    ServerMetrics _metrics;
+    unique_ptr<tcp::acceptor> _admin_acceptor;
+
+    void reload_conf();
+    void wait_signal();
+
+    void admin_accept();
+    void admin_read(shared_ptr<Connection> conn);
 
     void accept_handle(shared_ptr<Connection> conn,
                        const e_code& err);
@@ -82,18 +172,31 @@ private:
                       const e_code& err,
                       std::size_t bytes_transferred);
 
+    void read(shared_ptr<Connection> conn);
+
     void read_handle(shared_ptr<Connection> conn,
                      const e_code& err,
                      std::size_t bytes_transferred);
 
-    size_t read_complete(shared_ptr<Connection> conn,
-                         const e_code& err,
-                         size_t size);
+    // 增量解析 request_buffer 中新读到的数据
+    READ_STATUS read_complete(shared_ptr<Connection> conn);
+
+    // 丢弃 request_buffer 头部已处理的数据
+    void consume(shared_ptr<Connection> conn, size_t size);
+
+    // 响应写完后写一条二进制访问日志
+    void log_access(shared_ptr<Connection> conn, std::size_t bytes_out);
 
 // 业务端实现
 protected:
     // 路由
     virtual void router(shared_ptr<Connection> conn) = 0;
+
+    /*
+     * 请求头解析完成后调用，决定请求体的去向
+     * 默认追加到 request->Data()，业务端可以重写，例如直接写文件
+     */
+    virtual BodySink body_sink(shared_ptr<Connection> conn);
 };
 
 } // namespace webserver
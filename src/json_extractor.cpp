@@ -0,0 +1,245 @@
+#include "json_extractor.h"
+
+namespace http {
+namespace json {
+
+JsonExtractor::JsonExtractor(const std::vector<std::string>& fields,
+                             std::map<std::string, std::string>& ret)
+    : _ret(ret),
+      _found(0),
+      _error(false) {
+    for (const auto& field : fields) {
+        _targets.insert(field);
+        _prefixes.insert("");
+        for (size_t pos = field.find('.'); pos != std::string::npos; pos = field.find('.', pos + 1)) {
+            _prefixes.insert(field.substr(0, pos));
+        }
+        _prefixes.insert(field);
+    }
+}
+
+bool JsonExtractor::extract(const std::string& data) {
+    bool ok = Json::sax_parse(data, this);
+    return (ok && !_error) || finished();
+}
+
+bool JsonExtractor::extract(std::istream& in) {
+    bool ok = Json::sax_parse(in, this);
+    return (ok && !_error) || finished();
+}
+
+bool JsonExtractor::enter_value(std::string& path) {
+    path.clear();
+    if (_frames.empty()) {
+        return _prefixes.count(path) > 0;
+    }
+
+    Frame& frame = _frames.back();
+    if (!frame.relevant) {
+        return false;
+    }
+
+    path = frame.path;
+    if (!path.empty()) {
+        path += '.';
+    }
+    if (frame.array) {
+        path += std::to_string(frame.index++);
+    } else {
+        path += _key;
+    }
+    return _prefixes.count(path) > 0;
+}
+
+bool JsonExtractor::capture(Json value) {
+    Json* parent = _capture_stack.back();
+    if (parent->is_array()) {
+        parent->push_back(std::move(value));
+    } else {
+        (*parent)[_key] = std::move(value);
+    }
+    return true;
+}
+
+bool JsonExtractor::target_value(std::string& path) {
+    return enter_value(path) && _targets.count(path) > 0;
+}
+
+bool JsonExtractor::found_scalar(const std::string& path, const std::string& text) {
+    found(path, text);
+    return !finished();
+}
+
+bool JsonExtractor::start_container(bool array) {
+    Json container = array ? Json::array() : Json::object();
+
+    if (!_capture_stack.empty()) {
+        Json* parent = _capture_stack.back();
+        Json* child;
+        if (parent->is_array()) {
+            parent->push_back(std::move(container));
+            child = &parent->back();
+        } else {
+            child = &((*parent)[_key] = std::move(container));
+        }
+        _capture_stack.push_back(child);
+        return true;
+    }
+
+    std::string path;
+    bool relevant = enter_value(path);
+    if (relevant && _targets.count(path) > 0) {
+        _capture = std::move(container);
+        _capture_path = path;
+        _capture_stack.push_back(&_capture);
+        return true;
+    }
+
+    Frame frame;
+    frame.array = array;
+    frame.index = 0;
+    frame.relevant = relevant;
+    if (relevant) {
+        frame.path = path;
+    }
+    _frames.push_back(frame);
+    return true;
+}
+
+bool JsonExtractor::end_container() {
+    if (!_capture_stack.empty()) {
+        _capture_stack.pop_back();
+        if (_capture_stack.empty()) {
+            found(_capture_path, _capture.dump());
+
+            // 子树中还可能包含其它请求的字段，例如同时请求了 "a" 和 "a.b"
+            std::string prefix = _capture_path.empty() ? "" : _capture_path + ".";
+            for (const auto& target : _targets) {
+                if (target.size() <= prefix.size() || target.compare(0, prefix.size(), prefix) != 0) {
+                    continue;
+                }
+                const Json* node = &_capture;
+                size_t pos = prefix.size();
+                while (node != nullptr && pos <= target.size()) {
+                    size_t end = target.find('.', pos);
+                    if (end == std::string::npos) {
+                        end = target.size();
+                    }
+                    std::string seg = target.substr(pos, end - pos);
+                    if (node->is_object() && node->count(seg) > 0) {
+                        node = &(*node)[seg];
+                    } else if (node->is_array() && !seg.empty() &&
+                               seg.find_first_not_of("0123456789") == std::string::npos &&
+                               std::stoul(seg) < node->size()) {
+                        node = &(*node)[std::stoul(seg)];
+                    } else {
+                        node = nullptr;
+                    }
+                    pos = end + 1;
+                }
+                if (node != nullptr) {
+                    found(target, node->is_string() ? node->get<std::string>() : node->dump());
+                }
+            }
+            _capture = Json();
+        }
+        return !finished();
+    }
+
+    if (!_frames.empty()) {
+        _frames.pop_back();
+    }
+    return true;
+}
+
+void JsonExtractor::found(const std::string& path, const std::string& value) {
+    if (_ret.count(path) == 0) {
+        ++_found;
+    }
+    _ret[path] = value;
+}
+
+bool JsonExtractor::finished() const {
+    return _found >= _targets.size() && _capture_stack.empty();
+}
+
+// 不在请求字段中的值不做任何转换
+bool JsonExtractor::null() {
+    if (!_capture_stack.empty()) {
+        return capture(Json());
+    }
+    std::string path;
+    return target_value(path) ? found_scalar(path, "null") : true;
+}
+
+bool JsonExtractor::boolean(bool val) {
+    if (!_capture_stack.empty()) {
+        return capture(Json(val));
+    }
+    std::string path;
+    return target_value(path) ? found_scalar(path, val ? "true" : "false") : true;
+}
+
+bool JsonExtractor::number_integer(Json::number_integer_t val) {
+    if (!_capture_stack.empty()) {
+        return capture(Json(val));
+    }
+    std::string path;
+    return target_value(path) ? found_scalar(path, std::to_string(val)) : true;
+}
+
+bool JsonExtractor::number_unsigned(Json::number_unsigned_t val) {
+    if (!_capture_stack.empty()) {
+        return capture(Json(val));
+    }
+    std::string path;
+    return target_value(path) ? found_scalar(path, std::to_string(val)) : true;
+}
+
+bool JsonExtractor::number_float(Json::number_float_t val, const std::string& s) {
+    if (!_capture_stack.empty()) {
+        return capture(Json(val));
+    }
+    std::string path;
+    return target_value(path) ? found_scalar(path, s) : true;
+}
+
+bool JsonExtractor::string(std::string& val) {
+    if (!_capture_stack.empty()) {
+        return capture(Json(std::move(val)));
+    }
+    std::string path;
+    return target_value(path) ? found_scalar(path, val) : true;
+}
+
+bool JsonExtractor::start_object(std::size_t) {
+    return start_container(false);
+}
+
+bool JsonExtractor::key(std::string& val) {
+    if (!_capture_stack.empty() || _frames.empty() || _frames.back().relevant) {
+        _key = val;
+    }
+    return true;
+}
+
+bool JsonExtractor::end_object() {
+    return end_container();
+}
+
+bool JsonExtractor::start_array(std::size_t) {
+    return start_container(true);
+}
+
+bool JsonExtractor::end_array() {
+    return end_container();
+}
+
+bool JsonExtractor::parse_error(std::size_t,
+                                const std::string&,
+                                const nlohmann::detail::exception&) {
+    _error = true;
+    return false;
+}
+
+}}
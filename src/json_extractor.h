@@ -0,0 +1,91 @@
+#ifndef __HTTP_JSON_EXTRACTOR_H__
+#define __HTTP_JSON_EXTRACTOR_H__
+
+#include <map>
+#include <string>
+#include <vector>
+#include <istream>
+#include <unordered_set>
+
+#include "third/json.hpp"
+
+using Json = nlohmann::json;
+
+namespace http {
+namespace json {
+
+/*
+ * 基于 SAX 的 json 字段提取
+ *
+ * 不构建整棵 DOM，只保存请求的字段；字段值为对象或数组时只构建该子树。
+ * 所有字段都找到后立即停止解析。
+ *
+ * 字段路径用 '.' 分隔，数组下标用数字，例如 "user.name"、"items.0.id"
+ * 字段值：字符串为原始内容，其它类型为 json 文本
+ */
+class JsonExtractor {
+public:
+    JsonExtractor(const std::vector<std::string>& fields,
+                  std::map<std::string, std::string>& ret);
+
+    /*
+     * 功能 : 解析并提取字段
+     * ret  : json 合法（或在出错前已提取到全部字段）时返回 true
+     */
+    bool extract(const std::string& data);
+    bool extract(std::istream& in);
+
+    // SAX 接口
+    bool null();
+    bool boolean(bool val);
+    bool number_integer(Json::number_integer_t val);
+    bool number_unsigned(Json::number_unsigned_t val);
+    bool number_float(Json::number_float_t val, const std::string& s);
+    bool string(std::string& val);
+    bool start_object(std::size_t elements);
+    bool key(std::string& val);
+    bool end_object();
+    bool start_array(std::size_t elements);
+    bool end_array();
+    bool parse_error(std::size_t position,
+                     const std::string& last_token,
+                     const nlohmann::detail::exception& ex);
+
+private:
+    struct Frame {
+        bool array;
+        std::size_t index;
+        std::string path;
+        bool relevant;
+    };
+
+    // 进入一个值，返回该值的路径是否是某个字段或其前缀
+    bool enter_value(std::string& path);
+    // 当前值是请求的字段
+    bool target_value(std::string& path);
+    bool found_scalar(const std::string& path, const std::string& text);
+    // 把值加入正在构建的子树
+    bool capture(Json value);
+    bool start_container(bool array);
+    bool end_container();
+    void found(const std::string& path, const std::string& value);
+    bool finished() const;
+
+    std::unordered_set<std::string> _targets;
+    std::unordered_set<std::string> _prefixes;
+    std::map<std::string, std::string>& _ret;
+    std::size_t _found;
+    bool _error;
+
+    std::vector<Frame> _frames;
+    std::string _key;
+
+    // 字段值为对象或数组时构建子树
+    Json _capture;
+    std::string _capture_path;
+    std::vector<Json*> _capture_stack;
+};
+
+}}
+
+#endif
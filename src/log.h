@@ -1,12 +1,14 @@
 #ifndef __HTTP_LOG_H__
 #define __HTTP_LOG_H__
 
-#include <iostream>
-#include <fstream>
+#include <atomic>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <vector>
-#include <cstdio>
-#include <sstream>
 #include <string>
+#include "async_logger.h"
+#include "log_format.h"
 
 using std::string;
 
@@ -33,76 +35,164 @@ const std::vector<string> LOG_LEVEL_STR
     "FATAL"
 };
 
-const string positive_log_file="webserver.log";
-const string negative_log_file="webserver.log.wf";
-
-static void msnprintf(string& buffer, string pattern){}
-template <class T, class ...Args>
-static void msnprintf(string& buffer, string pattern, T head, Args... rest) 
+/*
+ * 运行时的日志级别，低于它的 LOGOUT 直接返回，不计算参数；默认 TRACE
+ */
+inline std::atomic<int>& log_level_storage()
 {
-    size_t pos = pattern.find("%");
-    while (pos != string::npos && pos > 0 && pattern[pos-1] == '\\') {
-        pattern = pattern.substr(0, pos-1) + pattern.substr(pos);
-        pos = pattern.find("%", pos);
-    }
+    static std::atomic<int> level(TRACE);
+    return level;
+}
 
-    if (pos == string::npos) { throw; }
+inline LOG_LEVEL log_level()
+{
+    return static_cast<LOG_LEVEL>(log_level_storage().load(std::memory_order_relaxed));
+}
 
-    std::stringstream istr;
-    istr << head;
-    buffer += pattern.substr(0, pos) + istr.str();
+inline void set_log_level(LOG_LEVEL level)
+{
+    log_level_storage().store(level, std::memory_order_relaxed);
+}
 
-    string rest_pattern = pattern.substr(pos+1);
+inline bool log_enabled(LOG_LEVEL level)
+{
+    return level >= log_level();
+}
 
-    if (sizeof...(rest) == 0) {
-        pos = rest_pattern.find("%");
-        if (pos != string::npos && pos > 0 && rest_pattern[pos-1] != '\\') { 
-            throw; 
-        } else if (pos != string::npos) {
-            rest_pattern = rest_pattern.substr(0, pos-1) + rest_pattern.substr(pos);
+// "INFO" -> INFO，不区分大小写
+inline bool parse_log_level(const string& name, LOG_LEVEL& level)
+{
+    for (size_t i = 0; i < LOG_LEVEL_STR.size(); ++i) {
+        const string& str = LOG_LEVEL_STR[i];
+        if (name.size() == str.size() &&
+            std::equal(name.begin(), name.end(), str.begin(),
+                       [](char a, char b) { return toupper(static_cast<unsigned char>(a)) == b; })) {
+            level = static_cast<LOG_LEVEL>(i);
+            return true;
         }
-        buffer += rest_pattern;
     }
-
-    msnprintf(buffer, rest_pattern, rest...);
+    return false;
 }
 
-template <class T, class ...Args>
-static void LOGOUT(LOG_LEVEL level, T head, Args... rest)
-{
-    string log_file;
-    switch (level){
-        case TRACE:
-        case DEBUG:
-        case INFO:
-            log_file = positive_log_file;
-        break;
-        case WARN:
-        case ERROR:
-        case FATAL:
-            log_file = negative_log_file;
-        break;
-        default:
-            log_file = negative_log_file;
-    };
-
-    std::ofstream fout(log_file, std::ios::app);
-    if (!fout.is_open()) {
-        std::cerr << "open log file fatal!" << std::endl;
+/*
+ * 调用点的采样：每 n 次写一次，用于 LOGOUT_EVERY_N
+ */
+class LogSampler {
+public:
+    explicit LogSampler(uint64_t n) : _n(n == 0 ? 1 : n), _count(0) {}
+
+    bool sample() {
+        if (_count.fetch_add(1, std::memory_order_relaxed) % _n == 0) {
+            return true;
+        }
+        AsyncLogger::instance().add_suppressed();
+        return false;
     }
 
-    time_t rawtime;
-    time(&rawtime);
-    string time_str(ctime(&rawtime));
-    time_str = time_str.substr(0, time_str.size()-1);
+private:
+    const uint64_t _n;
+    std::atomic<uint64_t> _count;
+};
 
-    string buffer;
-    msnprintf(buffer, head, rest...);
+/*
+ * 调用点的限速：每秒最多写 lines_per_second 行，用于 LOGOUT_RATE
+ * 多个线程同时跨秒时可能多写几行
+ */
+class LogRateLimiter {
+public:
+    explicit LogRateLimiter(uint32_t lines_per_second)
+        : _limit(lines_per_second), _second(0), _count(0) {}
+
+    bool allow() {
+        int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t second = _second.load(std::memory_order_relaxed);
+        if (now != second && _second.compare_exchange_strong(second, now, std::memory_order_relaxed)) {
+            _count.store(0, std::memory_order_relaxed);
+        }
+        if (_count.fetch_add(1, std::memory_order_relaxed) < _limit) {
+            return true;
+        }
+        AsyncLogger::instance().add_suppressed();
+        return false;
+    }
 
-    fout << LOG_LEVEL_STR[level] << ":" << time_str << " " << buffer << "\n";
-    fout.close();
+private:
+    const uint32_t _limit;
+    std::atomic<int64_t> _second;
+    std::atomic<uint32_t> _count;
+};
+
+/*
+ * 写一行日志：格式化到栈上的缓冲区后写入当前线程的环形缓冲区，
+ * 由 AsyncLogger 的后台线程写到文件；FATAL 等待写到文件后返回
+ * 一般通过 LOGOUT 调用
+ */
+template <class ...Args>
+void log_line(LOG_LEVEL level, const char* pattern, const Args&... args)
+{
+    LineBuffer line;
+    const string& level_str = LOG_LEVEL_STR[level];
+    line.append(level_str.data(), level_str.size());
+    line.append(':');
+    size_t time_size;
+    const char* time_str = cached_time(time_size);
+    line.append(time_str, time_size);
+    line.append(' ');
+    format_to(line, pattern, args...);
+    line.finish();
+
+    AsyncLogger& logger = AsyncLogger::instance();
+    logger.append(level >= WARN ? LogTarget::Negative : LogTarget::Positive, line.data(), line.size());
+    if (level == FATAL) {
+        logger.flush();
+    }
 }
 
 }}
 
+#define HTTP_LOG_CHECK_PATTERN(pattern, ...) \
+    static_assert(http::log::count_placeholders(pattern) == \
+                  sizeof(http::log::count_args(__VA_ARGS__)) - 1, \
+                  "LOGOUT: the number of % in pattern does not match the arguments")
+
+/*
+ * LOGOUT(level, pattern, args...)
+ * pattern 必须是字符串字面量，% 的个数与参数个数不一致时编译失败
+ * 低于 log_level() 时不计算参数
+ */
+#define LOGOUT(level, pattern, ...) \
+    do { \
+        HTTP_LOG_CHECK_PATTERN(pattern, ##__VA_ARGS__); \
+        if (http::log::log_enabled(level)) { \
+            http::log::log_line(level, pattern, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+/*
+ * LOGOUT_EVERY_N(level, n, pattern, args...)
+ * 同一调用点每 n 次写一次，用于热点路径
+ */
+#define LOGOUT_EVERY_N(level, n, pattern, ...) \
+    do { \
+        HTTP_LOG_CHECK_PATTERN(pattern, ##__VA_ARGS__); \
+        static http::log::LogSampler log_sampler_(n); \
+        if (http::log::log_enabled(level) && log_sampler_.sample()) { \
+            http::log::log_line(level, pattern, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+/*
+ * LOGOUT_RATE(level, lines_per_second, pattern, args...)
+ * 同一调用点每秒最多写 lines_per_second 行，超过的计入 LogStats::suppressed
+ */
+#define LOGOUT_RATE(level, lines_per_second, pattern, ...) \
+    do { \
+        HTTP_LOG_CHECK_PATTERN(pattern, ##__VA_ARGS__); \
+        static http::log::LogRateLimiter log_limiter_(lines_per_second); \
+        if (http::log::log_enabled(level) && log_limiter_.allow()) { \
+            http::log::log_line(level, pattern, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
 #endif
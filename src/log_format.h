@@ -0,0 +1,173 @@
+#ifndef __HTTP_LOG_FORMAT_H__
+#define __HTTP_LOG_FORMAT_H__
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+namespace http {
+namespace log {
+
+/*
+ * 日志格式化
+ *
+ * 模式串中每个 % 对应一个参数，\% 输出 %
+ * % 的个数在编译期计算，与参数个数不一致时编译失败（见 log.h 中的 LOGOUT）；
+ * 运行时一遍扫描模式串，直接写到栈上的 LineBuffer
+ */
+
+// 编译期计算 % 的个数，pattern 需要是字符串字面量
+constexpr size_t count_placeholders(const char* p) {
+    return *p == '\0' ? 0
+           : (*p == '\\' && p[1] == '%') ? count_placeholders(p + 2)
+           : (*p == '%' ? 1 : 0) + count_placeholders(p + 1);
+}
+
+// 只用于 sizeof 中计算参数个数，不求值
+template <class ...Args>
+char (&count_args(const Args&...))[sizeof...(Args) + 1];
+
+/*
+ * 一行日志，超过容量时截断，末尾总是保留换行的位置
+ */
+class LineBuffer {
+public:
+    static const size_t CAPACITY = 4096;
+
+    LineBuffer() : _size(0) {}
+
+    void append(const char* data, size_t size) {
+        size_t left = CAPACITY - 1 - _size;
+        if (size > left) {
+            size = left;
+        }
+        memcpy(_data + _size, data, size);
+        _size += size;
+    }
+
+    void append(char c) {
+        if (_size < CAPACITY - 1) {
+            _data[_size++] = c;
+        }
+    }
+
+    // 追加换行，之后不能再追加
+    void finish() {
+        _data[_size++] = '\n';
+    }
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    char _data[CAPACITY];
+    size_t _size;
+};
+
+inline void append_value(LineBuffer& out, const char* value) {
+    out.append(value, strlen(value));
+}
+
+inline void append_value(LineBuffer& out, char* value) {
+    out.append(value, strlen(value));
+}
+
+inline void append_value(LineBuffer& out, const std::string& value) {
+    out.append(value.data(), value.size());
+}
+
+inline void append_value(LineBuffer& out, char value) {
+    out.append(value);
+}
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+append_value(LineBuffer& out, T value) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    // 取负数的绝对值不会溢出
+    unsigned long long abs = value < 0 ? 0ULL - static_cast<unsigned long long>(value)
+                                       : static_cast<unsigned long long>(value);
+    do {
+        *--p = static_cast<char>('0' + abs % 10);
+        abs /= 10;
+    } while (abs > 0);
+    if (value < 0) {
+        *--p = '-';
+    }
+    out.append(p, end - p);
+}
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+append_value(LineBuffer& out, T value) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    unsigned long long v = value;
+    do {
+        *--p = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    out.append(p, end - p);
+}
+
+// 与 stringstream 默认的精度一致
+template <class T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+append_value(LineBuffer& out, T value) {
+    char digits[32];
+    int size = snprintf(digits, sizeof(digits), "%g", static_cast<double>(value));
+    if (size > 0) {
+        out.append(digits, static_cast<size_t>(size) < sizeof(digits) ? size : sizeof(digits) - 1);
+    }
+}
+
+// 其它类型使用 operator<<
+template <class T>
+typename std::enable_if<!std::is_arithmetic<T>::value>::type
+append_value(LineBuffer& out, const T& value) {
+    std::ostringstream stream;
+    stream << value;
+    append_value(out, stream.str());
+}
+
+/*
+ * 输出到下一个 % 之前，返回 % 之后的位置
+ */
+inline const char* append_segment(LineBuffer& out, const char* p) {
+    const char* begin = p;
+    while (*p != '\0') {
+        if (*p == '\\' && p[1] == '%') {
+            out.append(begin, p - begin);
+            out.append('%');
+            p += 2;
+            begin = p;
+        } else if (*p == '%') {
+            out.append(begin, p - begin);
+            return p + 1;
+        } else {
+            ++p;
+        }
+    }
+    out.append(begin, p - begin);
+    return p;
+}
+
+inline void format_to(LineBuffer& out, const char* pattern) {
+    append_segment(out, pattern);
+}
+
+template <class T, class ...Args>
+void format_to(LineBuffer& out, const char* pattern, const T& head, const Args&... rest) {
+    pattern = append_segment(out, pattern);
+    append_value(out, head);
+    format_to(out, pattern, rest...);
+}
+
+}}
+
+#endif
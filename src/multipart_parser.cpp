@@ -0,0 +1,447 @@
+#include "multipart_parser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <boost/algorithm/string.hpp>
+
+namespace http {
+namespace multipart {
+
+// 段头上限
+static const size_t MAX_HEADER_SIZE = 16 * 1024;
+
+static string_view trim_view(string_view v) {
+    while (!v.empty() && (v.front() == ' ' || v.front() == '\t')) {
+        v.remove_prefix(1);
+    }
+    while (!v.empty() && (v.back() == ' ' || v.back() == '\t')) {
+        v.remove_suffix(1);
+    }
+    return v;
+}
+
+BoyerMooreHorspool::BoyerMooreHorspool(const string& pattern) : _pattern(pattern) {
+    size_t m = _pattern.size();
+    for (size_t i = 0; i < 256; ++i) {
+        _skip[i] = m;
+    }
+    for (size_t i = 0; i + 1 < m; ++i) {
+        _skip[(unsigned char)_pattern[i]] = m - 1 - i;
+    }
+}
+
+size_t BoyerMooreHorspool::search(const char* data, size_t size) const {
+    size_t m = _pattern.size();
+    if (m == 0 || size < m) {
+        return string::npos;
+    }
+
+    const char* pattern = _pattern.data();
+    const char last = pattern[m - 1];
+    size_t i = 0;
+    while (i <= size - m) {
+        char c = data[i + m - 1];
+        if (c == last && memcmp(data + i, pattern, m - 1) == 0) {
+            return i;
+        }
+        i += _skip[(unsigned char)c];
+    }
+    return string::npos;
+}
+
+size_t BoyerMooreHorspool::size() const {
+    return _pattern.size();
+}
+
+bool MultipartPart::is_file() const {
+    return filename.data() != nullptr;
+}
+
+void MultipartPart::clear() {
+    headers.clear();
+    name = string_view();
+    filename = string_view();
+    content_type = string_view();
+}
+
+MultipartParser::MultipartParser(const string& boundary)
+    : _delimiter("\r\n--" + boundary),
+      _searcher(_delimiter),
+      _state(PREAMBLE),
+      // 第一个分隔符前没有 CRLF，这里补上，统一按 CRLF--boundary 查找
+      _carry(CRLF) {
+}
+
+bool MultipartParser::extract_boundary(const string& content_type, string& boundary) {
+    string lower = boost::algorithm::to_lower_copy(content_type);
+    if (lower.find("multipart/") == string::npos) {
+        return false;
+    }
+    size_t pos = lower.find("boundary=");
+    if (pos == string::npos) {
+        return false;
+    }
+    pos += 9;
+
+    size_t end;
+    if (pos < content_type.size() && content_type[pos] == '"') {
+        ++pos;
+        end = content_type.find('"', pos);
+    } else {
+        end = content_type.find_first_of("; \t", pos);
+    }
+    if (end == string::npos) {
+        end = content_type.size();
+    }
+
+    boundary = content_type.substr(pos, end - pos);
+    // RFC 2046: boundary 长度 1~70
+    return !boundary.empty() && boundary.size() <= 70;
+}
+
+size_t MultipartParser::feed(const char* data, size_t size) {
+    size_t i = 0;
+    while (i < size && _state != ERROR) {
+        char c = data[i];
+        switch (_state) {
+            case PREAMBLE:
+            case BODY:
+                i += search_delimiter(data + i, size - i);
+                break;
+            case DELIMITER_END:
+                if (c == '\r') {
+                    _state = DELIMITER_LF;
+                } else if (c == '\n') {
+                    _header_buffer = CRLF;
+                    _state = HEADERS;
+                } else if (c == '-') {
+                    _state = DELIMITER_DASH;
+                } else if (c != ' ' && c != '\t') {
+                    _state = ERROR;
+                    break;
+                }
+                ++i;
+                break;
+            case DELIMITER_LF:
+                if (c != '\n') {
+                    _state = ERROR;
+                    break;
+                }
+                _header_buffer = CRLF;
+                _state = HEADERS;
+                ++i;
+                break;
+            case DELIMITER_DASH:
+                if (c != '-') {
+                    _state = ERROR;
+                    break;
+                }
+                _state = DONE;
+                ++i;
+                break;
+            case HEADERS:
+                i += read_headers(data + i, size - i);
+                break;
+            case DONE:
+                // epilogue，忽略
+                i = size;
+                break;
+            default:
+                break;
+        }
+    }
+    return i;
+}
+
+BodySink MultipartParser::sink() {
+    return [this](const char* data, size_t size){ feed(data, size); };
+}
+
+size_t MultipartParser::search_delimiter(const char* data, size_t size) {
+    const size_t dlen = _delimiter.size();
+
+    // 分隔符可能跨越上次 feed 的末尾
+    if (!_carry.empty()) {
+        size_t take = std::min(size, dlen - 1);
+        string window = _carry;
+        window.append(data, take);
+
+        size_t pos = _searcher.search(window.data(), window.size());
+        if (pos != string::npos && pos < _carry.size()) {
+            size_t consumed = pos + dlen - _carry.size();
+            emit(window.data(), pos);
+            _carry.clear();
+            delimiter_found();
+            return consumed;
+        }
+
+        if (take < dlen - 1) {
+            // 数据全部在 window 中，末尾仍可能是分隔符前缀
+            size_t keep = std::min(window.size(), dlen - 1);
+            emit(window.data(), window.size() - keep);
+            _carry = window.substr(window.size() - keep);
+            return size;
+        }
+
+        emit(_carry.data(), _carry.size());
+        _carry.clear();
+    }
+
+    size_t pos = _searcher.search(data, size);
+    if (pos != string::npos) {
+        emit(data, pos);
+        delimiter_found();
+        return pos + dlen;
+    }
+
+    // 分隔符以 \r 开头，末尾 dlen-1 字节内最后一个 \r 之后的数据才需要留到下次
+    size_t keep = 0;
+    size_t limit = std::min(size, dlen - 1);
+    for (size_t k = 1; k <= limit; ++k) {
+        if (data[size - k] == '\r') {
+            keep = k;
+        }
+    }
+    emit(data, size - keep);
+    _carry.assign(data + size - keep, keep);
+    return size;
+}
+
+size_t MultipartParser::read_headers(const char* data, size_t size) {
+    // 只在新数据中查找，跨越两次 feed 的 CRLFCRLF 用上次末尾最多 3 字节拼接查找
+    size_t old = _header_buffer.size();
+    size_t tail = std::min(old, CRLFCRLF.size() - 1);
+    size_t head = std::min(size, CRLFCRLF.size() - 1);
+    string joint = _header_buffer.substr(old - tail);
+    joint.append(data, head);
+
+    // end : 段头在 _header_buffer 中的长度，不含 CRLFCRLF
+    size_t end;
+    size_t consumed;
+    size_t pos = joint.find(CRLFCRLF);
+    if (pos != string::npos) {
+        end = old - tail + pos;
+        consumed = pos + CRLFCRLF.size() - tail;
+    } else {
+        const char* found = std::search(data, data + size, CRLFCRLF.begin(), CRLFCRLF.end());
+        if (found == data + size) {
+            if (old + size > MAX_HEADER_SIZE) {
+                _state = ERROR;
+                return 0;
+            }
+            _header_buffer.append(data, size);
+            return size;
+        }
+        end = old + (found - data);
+        consumed = found - data + CRLFCRLF.size();
+    }
+
+    if (end > MAX_HEADER_SIZE) {
+        _state = ERROR;
+        return 0;
+    }
+    if (end > old) {
+        _header_buffer.append(data, end - old);
+    } else {
+        _header_buffer.resize(end);
+    }
+    if (!parse_headers(end)) {
+        _state = ERROR;
+        return consumed;
+    }
+
+    _state = BODY;
+    if (on_part_begin) {
+        on_part_begin(_part);
+    }
+    return consumed;
+}
+
+bool MultipartParser::parse_headers(size_t size) {
+    _part.clear();
+
+    // _header_buffer 以 CRLF 开头
+    string_view block(_header_buffer.data(), size);
+    size_t cur = CRLF.size();
+    while (cur < block.size()) {
+        size_t end = block.find(CRLF, cur);
+        if (end == string_view::npos) {
+            end = block.size();
+        }
+        string_view line = block.substr(cur, end - cur);
+        cur = end + CRLF.size();
+
+        size_t colon = line.find(':');
+        if (colon == string_view::npos) {
+            return false;
+        }
+        string_view key = trim_view(line.substr(0, colon));
+        string_view value = trim_view(line.substr(colon + 1));
+        _part.headers.push_back(std::make_pair(key, value));
+
+        if (boost::algorithm::iequals(key, "content-type")) {
+            _part.content_type = value;
+        } else if (boost::algorithm::iequals(key, "content-disposition")) {
+            // form-data; name="field"; filename="a.txt"
+            size_t p = value.find(';');
+            while (p != string_view::npos && p < value.size()) {
+                ++p;
+                size_t eq = value.find('=', p);
+                if (eq == string_view::npos) {
+                    break;
+                }
+                string_view pkey = trim_view(value.substr(p, eq - p));
+                size_t vbegin = eq + 1;
+                while (vbegin < value.size() && value[vbegin] == ' ') {
+                    ++vbegin;
+                }
+
+                string_view pval;
+                if (vbegin < value.size() && value[vbegin] == '"') {
+                    size_t vend = vbegin + 1;
+                    while (vend < value.size() && value[vend] != '"') {
+                        vend += value[vend] == '\\' ? 2 : 1;
+                    }
+                    vend = std::min(vend, value.size());
+                    pval = value.substr(vbegin + 1, vend - vbegin - 1);
+                    p = value.find(';', vend);
+                } else {
+                    p = value.find(';', vbegin);
+                    size_t vend = p == string_view::npos ? value.size() : p;
+                    pval = trim_view(value.substr(vbegin, vend - vbegin));
+                }
+
+                if (boost::algorithm::iequals(pkey, "name")) {
+                    _part.name = pval;
+                } else if (boost::algorithm::iequals(pkey, "filename")) {
+                    _part.filename = pval;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void MultipartParser::emit(const char* data, size_t size) {
+    if (size > 0 && _state == BODY && on_part_data) {
+        on_part_data(_part, data, size);
+    }
+}
+
+void MultipartParser::delimiter_found() {
+    if (_state == BODY && on_part_end) {
+        on_part_end(_part);
+    }
+    _state = DELIMITER_END;
+}
+
+bool MultipartParser::done() const {
+    return _state == DONE;
+}
+
+bool MultipartParser::error() const {
+    return _state == ERROR;
+}
+
+MultipartForm::MultipartForm(const string& boundary, const string& upload_dir)
+    : _parser(boundary),
+      _upload_dir(upload_dir),
+      _error(false),
+      _in_file(false),
+      _file(nullptr),
+      _value(nullptr) {
+    _parser.on_part_begin = [this](const MultipartPart& part){ part_begin(part); };
+    _parser.on_part_data = [this](const MultipartPart&, const char* data, size_t size){ part_data(data, size); };
+    _parser.on_part_end = [this](const MultipartPart&){ part_end(); };
+}
+
+MultipartForm::~MultipartForm() {
+    if (_file != nullptr) {
+        fclose(_file);
+    }
+}
+
+size_t MultipartForm::feed(const char* data, size_t size) {
+    return _parser.feed(data, size);
+}
+
+BodySink MultipartForm::sink() {
+    return [this](const char* data, size_t size){ feed(data, size); };
+}
+
+void MultipartForm::part_begin(const MultipartPart& part) {
+    string name = part.name.to_string();
+    if (!part.is_file()) {
+        _value = &_fields[name];
+        _value->clear();
+        return;
+    }
+
+    UploadFile file;
+    file.name = name;
+    file.filename = part.filename.to_string();
+    file.content_type = part.content_type.to_string();
+    file.size = 0;
+
+    if (_upload_dir.empty()) {
+        _value = &_fields[name];
+        _value->clear();
+    } else {
+        // 文件名由客户端提供，不能直接用作路径
+        string path = _upload_dir + "/upload_XXXXXX";
+        int fd = mkstemp(&path[0]);
+        if (fd < 0 || (_file = fdopen(fd, "wb")) == nullptr) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            _error = true;
+        }
+        file.path = path;
+    }
+    _files.push_back(file);
+    _in_file = true;
+}
+
+void MultipartForm::part_data(const char* data, size_t size) {
+    if (_file != nullptr) {
+        if (fwrite(data, 1, size, _file) != size) {
+            _error = true;
+        }
+    } else if (_value != nullptr) {
+        _value->append(data, size);
+    }
+    if (_in_file) {
+        _files.back().size += size;
+    }
+}
+
+void MultipartForm::part_end() {
+    if (_file != nullptr) {
+        if (fclose(_file) != 0) {
+            _error = true;
+        }
+        _file = nullptr;
+    }
+    _value = nullptr;
+    _in_file = false;
+}
+
+bool MultipartForm::done() const {
+    return !_error && _parser.done();
+}
+
+bool MultipartForm::error() const {
+    return _error || _parser.error();
+}
+
+const unordered_map<string, string>& MultipartForm::fields() const {
+    return _fields;
+}
+
+const vector<UploadFile>& MultipartForm::files() const {
+    return _files;
+}
+
+}}
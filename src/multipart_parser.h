@@ -0,0 +1,176 @@
+#ifndef __HTTP_MULTIPART_PARSER_H__
+#define __HTTP_MULTIPART_PARSER_H__
+
+#include "http_common.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+#include <boost/utility/string_view.hpp>
+
+using std::string;
+using std::vector;
+using std::unordered_map;
+
+using namespace http::common;
+
+namespace http {
+namespace multipart {
+
+typedef boost::string_view string_view;
+
+/*
+ * Boyer-Moore-Horspool 子串查找
+ */
+class BoyerMooreHorspool {
+public:
+    explicit BoyerMooreHorspool(const string& pattern);
+
+    /*
+     * 返回 pattern 在 data 中第一次出现的位置，未找到返回 string::npos
+     */
+    size_t search(const char* data, size_t size) const;
+
+    size_t size() const;
+
+private:
+    string _pattern;
+    size_t _skip[256];
+};
+
+/*
+ * multipart 中的一段
+ * view 指向解析器内部缓存，仅在该段的回调期间有效
+ */
+struct MultipartPart {
+    vector<std::pair<string_view, string_view>> headers;
+    string_view name;
+    string_view filename;
+    string_view content_type;
+
+    bool is_file() const;
+    void clear();
+};
+
+typedef std::function<void(const MultipartPart& part)> PartHandler;
+typedef std::function<void(const MultipartPart& part, const char* data, size_t size)> PartDataHandler;
+
+/*
+ * multipart/form-data 流式解析
+ *
+ * 数据可以任意切分后多次 feed，段内数据直接通过 on_part_data 回调输出，
+ * 解析器只缓存段头以及可能跨越两次 feed 的分隔符前缀
+ */
+class MultipartParser {
+public:
+    enum STATE {
+        PREAMBLE = 0,
+        DELIMITER_END,  // 分隔符之后，"\r\n" 或 "--"
+        DELIMITER_LF,
+        DELIMITER_DASH,
+        HEADERS,
+        BODY,
+        DONE,
+        ERROR
+    };
+
+    explicit MultipartParser(const string& boundary);
+
+    /*
+     * 功能 : 从 content-type 中解析 boundary
+     * content_type : content-type header
+     * boundary : 解析结果
+     */
+    static bool extract_boundary(const string& content_type, string& boundary);
+
+    /*
+     * 功能 : 增量解析
+     * ret  : 消费的字节数，出错时小于 size
+     */
+    size_t feed(const char* data, size_t size);
+
+    // 作为 HttpServer::body_sink 使用
+    BodySink sink();
+
+    bool done() const;
+    bool error() const;
+
+    PartHandler on_part_begin;
+    PartDataHandler on_part_data;
+    PartHandler on_part_end;
+
+private:
+    size_t search_delimiter(const char* data, size_t size);
+    size_t read_headers(const char* data, size_t size);
+    bool parse_headers(size_t size);
+    void emit(const char* data, size_t size);
+    void delimiter_found();
+
+    string _delimiter;
+    BoyerMooreHorspool _searcher;
+    STATE _state;
+
+    // 上次 feed 末尾可能是分隔符前缀的数据
+    string _carry;
+    string _header_buffer;
+    MultipartPart _part;
+};
+
+/*
+ * 上传文件信息
+ */
+struct UploadFile {
+    string name;
+    string filename;
+    string content_type;
+    // 落盘路径，保存在内存中时为空
+    string path;
+    uint64_t size;
+};
+
+/*
+ * multipart/form-data 表单收集
+ * 普通字段保存在内存中，upload_dir 非空时文件直接写入该目录，否则也保存在内存中
+ */
+class MultipartForm {
+public:
+    MultipartForm(const string& boundary, const string& upload_dir = "");
+    ~MultipartForm();
+
+    MultipartForm(const MultipartForm&) = delete;
+    MultipartForm& operator=(const MultipartForm&) = delete;
+
+    size_t feed(const char* data, size_t size);
+    BodySink sink();
+
+    bool done() const;
+    bool error() const;
+
+    const unordered_map<string, string>& fields() const;
+    const vector<UploadFile>& files() const;
+
+private:
+    void part_begin(const MultipartPart& part);
+    void part_data(const char* data, size_t size);
+    void part_end();
+
+    MultipartParser _parser;
+    string _upload_dir;
+    bool _error;
+
+    unordered_map<string, string> _fields;
+    vector<UploadFile> _files;
+
+    // 当前段是文件
+    bool _in_file;
+    FILE* _file;
+    string* _value;
+};
+
+}}
+
+#endif
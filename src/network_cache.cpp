@@ -0,0 +1,174 @@
+#include "network_cache.h"
+
+using namespace std;
+
+namespace http {
+namespace qt_helper {
+
+NetworkCache::NetworkCache(qint64 memory_bytes, qint64 disk_bytes, const QString& directory, QObject *parent)
+    : QAbstractNetworkCache(parent),
+      _memory_bytes(memory_bytes),
+      _memory_size(0) {
+    if (!directory.isEmpty() && disk_bytes > 0) {
+        _disk.reset(new QNetworkDiskCache());
+        _disk->setCacheDirectory(directory);
+        _disk->setMaximumCacheSize(disk_bytes);
+    }
+}
+
+QNetworkCacheMetaData NetworkCache::metaData(const QUrl& url) {
+    auto it = _entries.find(url.toString().toStdString());
+    if (it != _entries.end()) {
+        return it->second.meta;
+    }
+    if (_disk != nullptr) {
+        QNetworkCacheMetaData meta = _disk->metaData(url);
+        if (meta.isValid()) {
+            return meta;
+        }
+    }
+    ++_stats.misses;
+    return QNetworkCacheMetaData();
+}
+
+void NetworkCache::updateMetaData(const QNetworkCacheMetaData& meta) {
+    auto it = _entries.find(meta.url().toString().toStdString());
+    if (it != _entries.end()) {
+        it->second.meta = meta;
+    }
+    if (_disk != nullptr) {
+        _disk->updateMetaData(meta);
+    }
+}
+
+QIODevice* NetworkCache::data(const QUrl& url) {
+    string key = url.toString().toStdString();
+    auto it = _entries.find(key);
+    if (it != _entries.end()) {
+        ++_stats.memory_hits;
+        _lru.splice(_lru.begin(), _lru, it->second.lru);
+        // 调用方负责释放
+        QBuffer* buffer = new QBuffer();
+        buffer->setData(it->second.data);
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
+    }
+
+    if (_disk != nullptr) {
+        unique_ptr<QIODevice> device(_disk->data(url));
+        if (device != nullptr) {
+            ++_stats.disk_hits;
+            QByteArray data = device->readAll();
+            store(key, _disk->metaData(url), data);
+            QBuffer* buffer = new QBuffer();
+            buffer->setData(data);
+            buffer->open(QIODevice::ReadOnly);
+            return buffer;
+        }
+    }
+    return nullptr;
+}
+
+bool NetworkCache::remove(const QUrl& url) {
+    // 下载中止时会调用 remove，释放对应的缓冲区
+    for (auto it = _inserting.begin(); it != _inserting.end();) {
+        if (it->second.url() == url) {
+            delete it->first;
+            it = _inserting.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    bool removed = false;
+    auto it = _entries.find(url.toString().toStdString());
+    if (it != _entries.end()) {
+        erase(it);
+        removed = true;
+    }
+    if (_disk != nullptr && _disk->remove(url)) {
+        removed = true;
+    }
+    return removed;
+}
+
+qint64 NetworkCache::cacheSize() const {
+    return _memory_size + (_disk != nullptr ? _disk->cacheSize() : 0);
+}
+
+QIODevice* NetworkCache::prepare(const QNetworkCacheMetaData& meta) {
+    if (!meta.isValid() || (_memory_bytes <= 0 && _disk == nullptr)) {
+        return nullptr;
+    }
+    QBuffer* buffer = new QBuffer();
+    buffer->open(QIODevice::ReadWrite);
+    _inserting[buffer] = meta;
+    return buffer;
+}
+
+void NetworkCache::insert(QIODevice* device) {
+    auto it = _inserting.find(device);
+    if (it == _inserting.end()) {
+        return;
+    }
+    QNetworkCacheMetaData meta = it->second;
+    _inserting.erase(it);
+    QByteArray data = static_cast<QBuffer*>(device)->data();
+    delete device;
+
+    ++_stats.inserts;
+    store(meta.url().toString().toStdString(), meta, data);
+
+    // saveToDisk 为 false 时 QNetworkDiskCache::prepare 返回 nullptr
+    if (_disk != nullptr) {
+        QIODevice* disk_device = _disk->prepare(meta);
+        if (disk_device != nullptr) {
+            disk_device->write(data);
+            _disk->insert(disk_device);
+        }
+    }
+}
+
+void NetworkCache::clear() {
+    _entries.clear();
+    _lru.clear();
+    _memory_size = 0;
+    if (_disk != nullptr) {
+        _disk->clear();
+    }
+}
+
+CacheStats NetworkCache::Stats() const {
+    return _stats;
+}
+
+void NetworkCache::store(const string& key, const QNetworkCacheMetaData& meta, const QByteArray& data) {
+    auto it = _entries.find(key);
+    if (it != _entries.end()) {
+        erase(it);
+    }
+    // 单个条目太大时只放在磁盘上，避免冲掉整个内存缓存
+    if (data.size() > _memory_bytes / 8) {
+        return;
+    }
+
+    _lru.push_front(key);
+    Entry& entry = _entries[key];
+    entry.meta = meta;
+    entry.data = data;
+    entry.lru = _lru.begin();
+    _memory_size += data.size();
+
+    while (_memory_size > _memory_bytes && !_lru.empty()) {
+        ++_stats.evictions;
+        erase(_entries.find(_lru.back()));
+    }
+}
+
+void NetworkCache::erase(unordered_map<string, Entry>::iterator it) {
+    _memory_size -= it->second.data.size();
+    _lru.erase(it->second.lru);
+    _entries.erase(it);
+}
+
+}}
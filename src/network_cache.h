@@ -0,0 +1,80 @@
+#ifndef __HTTP_NETWORK_CACHE_H__
+#define __HTTP_NETWORK_CACHE_H__
+
+#include <list>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include <QAbstractNetworkCache>
+#include <QNetworkCacheMetaData>
+#include <QNetworkDiskCache>
+#include <QBuffer>
+
+namespace http {
+namespace qt_helper {
+
+struct CacheStats {
+    // 从内存命中
+    uint64_t memory_hits = 0;
+    // 从磁盘命中，同时放入内存
+    uint64_t disk_hits = 0;
+    uint64_t misses = 0;
+    uint64_t inserts = 0;
+    // 内存中因超过容量被淘汰的条目
+    uint64_t evictions = 0;
+};
+
+/*
+ * NetworkCache
+ *
+ * 内存 LRU 加可选的 QNetworkDiskCache，两级都限制大小
+ * 同一个渲染进程中的 WebPage 共享同一个 NetworkAccessManager 和 NetworkCache，
+ * 同一站点的公共脚本、样式只下载一次；QNetworkDiskCache 不能多进程共享，每个渲染进程使用自己的目录
+ */
+class NetworkCache: public QAbstractNetworkCache {
+    Q_OBJECT
+
+public:
+    // directory 为空时只使用内存
+    NetworkCache(qint64 memory_bytes, qint64 disk_bytes, const QString& directory, QObject *parent = 0);
+
+    QNetworkCacheMetaData metaData(const QUrl& url);
+    void updateMetaData(const QNetworkCacheMetaData& meta);
+    QIODevice* data(const QUrl& url);
+    bool remove(const QUrl& url);
+    qint64 cacheSize() const;
+    QIODevice* prepare(const QNetworkCacheMetaData& meta);
+    void insert(QIODevice* device);
+
+    CacheStats Stats() const;
+
+public slots:
+    void clear();
+
+private:
+    struct Entry {
+        QNetworkCacheMetaData meta;
+        QByteArray data;
+        std::list<std::string>::iterator lru;
+    };
+
+    void store(const std::string& key, const QNetworkCacheMetaData& meta, const QByteArray& data);
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+
+    qint64 _memory_bytes;
+    qint64 _memory_size;
+    std::unordered_map<std::string, Entry> _entries;
+    // 最近使用的在前
+    std::list<std::string> _lru;
+
+    // prepare 返回的、还没有 insert 的缓冲区
+    std::unordered_map<QIODevice*, QNetworkCacheMetaData> _inserting;
+
+    std::unique_ptr<QNetworkDiskCache> _disk;
+    CacheStats _stats;
+};
+
+}}
+
+#endif
@@ -3,19 +3,71 @@
 namespace http {
 namespace qt_helper {
 
-NetworkAccessManager::NetworkAccessManager(http::response::Response& response, QObject *parent)
+NetworkAccessManager::NetworkAccessManager(QObject *parent)
     : QNetworkAccessManager(parent),
-      _response(response) {
+      _generation(0) {
     connect(this, SIGNAL(finished(QNetworkReply*)), SLOT(replyFinished(QNetworkReply*)));
 }
 
+void NetworkAccessManager::setResponse(QWebPage* page, http::response::Response* response) {
+    if (response == nullptr) {
+        _bindings.erase(page);
+        return;
+    }
+    Binding& binding = _bindings[page];
+    binding.response = response;
+    binding.generation = ++_generation;
+}
+
+void NetworkAccessManager::setFilter(const ResourceFilter& filter) {
+    _matcher = ResourceMatcher(filter);
+}
+
+NetworkAccessManager::NetworkState NetworkAccessManager::State(QWebPage* page) const {
+    auto it = _bindings.find(page);
+    return it != _bindings.end() ? it->second.state : NetworkState();
+}
+
+NetworkAccessManager::Binding* NetworkAccessManager::binding(QWebPage* page, uint64_t generation) {
+    auto it = _bindings.find(page);
+    if (it == _bindings.end() || it->second.generation != generation) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+NetworkAccessManager::Binding* NetworkAccessManager::binding(const QNetworkRequest& req, bool& main_document) {
+    // WebKit 把发起请求的 QWebFrame 设为 originatingObject
+    QWebFrame* frame = qobject_cast<QWebFrame*>(req.originatingObject());
+    if (frame == nullptr) {
+        return nullptr;
+    }
+    auto it = _bindings.find(frame->page());
+    if (it == _bindings.end()) {
+        return nullptr;
+    }
+    main_document = frame == frame->page()->mainFrame()
+                    && resource_type(req.url().path().toStdString(), req.rawHeader("Accept").toStdString())
+                           == ResourceType::Document;
+    return &it->second;
+}
+
 void NetworkAccessManager::replyFinished(QNetworkReply *reply) {
-    if (_response.StatusCode().empty() || _response.StatusCode() == "301") {
-        _response.setStatusCode(std::to_string(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()));
-        _response.setStatusDescribe(reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toString().toStdString());
-        _response.setProtocol("HTTP/1.1");
+    bool main_document = false;
+    Binding* bound = binding(reply->request(), main_document);
+    if (bound == nullptr) {
+        return;
+    }
+    http::response::Response* response = bound->response;
+    if (!main_document && reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()) {
+        ++response->setResources().cached;
+    }
+    if (response->StatusCode().empty() || response->StatusCode() == "301") {
+        response->setStatusCode(std::to_string(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()));
+        response->setStatusDescribe(reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toString().toStdString());
+        response->setProtocol("HTTP/1.1");
         foreach (QByteArray headerName, reply->rawHeaderList()) {
-            _response.setHeader(headerName.toStdString(), reply->rawHeader(headerName).toStdString());
+            response->setHeader(headerName.toStdString(), reply->rawHeader(headerName).toStdString());
         }
     }
 }
@@ -25,30 +77,179 @@ QNetworkReply* NetworkAccessManager::createRequest(QNetworkAccessManager::Operat
                                                    QIODevice *data) {
     // 不需要手动指定 accept-encoding : gzip
     // https://code.qt.io/cgit/qt/qtbase.git/tree/src/network/access/qhttpnetworkconnection.cpp?h=5.11#n299
-    return QNetworkAccessManager::createRequest(op, req, data);
+    bool main_document = false;
+    Binding* bound = binding(req, main_document);
+    if (bound == nullptr) {
+        return QNetworkAccessManager::createRequest(op, req, data);
+    }
+
+    if (!main_document) {
+        ResourceType type = resource_type(req.url().path().toStdString(), req.rawHeader("Accept").toStdString());
+        http::response::ResourceStats& stats = bound->response->setResources();
+        if (_matcher.block(req.url().toString().toStdString(), req.url().host().toStdString(), type)) {
+            ++stats.blocked;
+            // 空 url 的请求立即以错误结束，不会发出
+            return QNetworkAccessManager::createRequest(op, QNetworkRequest(QUrl()), data);
+        }
+        ++stats.fetched;
+    }
+
+    QNetworkReply* reply = QNetworkAccessManager::createRequest(op, req, data);
+    ++bound->state.inflight;
+    track(reply, qobject_cast<QWebFrame*>(req.originatingObject())->page(), bound->generation, main_document);
+    return reply;
 }
 
-WebPage::WebPage(QApplication& app,
-                 http::response::Response& response,
-                 QObject *parent)
+void NetworkAccessManager::track(QNetworkReply* reply, QWebPage* page, uint64_t generation, bool main_document) {
+    std::shared_ptr<qint64> received = std::make_shared<qint64>(0);
+    connect(reply, &QNetworkReply::downloadProgress, this,
+            [this, page, generation, main_document, received](qint64 bytes, qint64) {
+        Binding* bound = binding(page, generation);
+        if (bound != nullptr && !main_document && bytes > *received) {
+            bound->response->setResources().fetched_bytes += bytes - *received;
+        }
+        *received = bytes;
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, page, generation, main_document]() {
+        Binding* bound = binding(page, generation);
+        if (bound == nullptr) {
+            return;
+        }
+        --bound->state.inflight;
+        if (main_document) {
+            bound->state.document_loaded = true;
+        }
+    });
+}
 
-    : QWebPage(parent),
-      _response(response), 
-      _app(app) {
+using http::response::RenderCompletion;
+
+// 元素数和文本长度，比序列化整个 DOM 便宜
+static const QString DOM_SIGNATURE =
+    "(function() { var b = document.body;"
+    " return document.getElementsByTagName('*').length + ':' + (b ? b.textContent.length : 0); })()";
 
-    _nam = std::unique_ptr<NetworkAccessManager>(new NetworkAccessManager(_response));
-    setNetworkAccessManager(_nam.get());
+WebPage::WebPage(NetworkAccessManager* nam, QObject *parent)
+    : QWebPage(parent),
+      _nam(nam),
+      _response(nullptr) {
+    if (_nam == nullptr) {
+        _own_nam = std::unique_ptr<NetworkAccessManager>(new NetworkAccessManager());
+        _nam = _own_nam.get();
+    }
+    setNetworkAccessManager(_nam);
     connect(mainFrame(), &QWebFrame::loadFinished, this, &WebPage::pageLoaded);
+
+    _budget.setSingleShot(true);
+    connect(&_budget, &QTimer::timeout, [this]() { finish(RenderCompletion::Timeout); });
+    connect(&_poll, &QTimer::timeout, [this]() { check(); });
+}
+
+WebPage::~WebPage() {
+    _nam->setResponse(this, nullptr);
 }
 
-void WebPage::load(const QString& url) { 
+void WebPage::load(const QString& url,
+                   const http::render::CompletionOptions& completion,
+                   http::response::Response& response,
+                   LoadHandler handler) {
+    _response = &response;
+    _handler = handler;
+    _completion = completion;
+    _nam->setResponse(this, _response);
+
+    _idle_since.invalidate();
+    _stable_since.invalidate();
+    _dom_signature = QString();
+    _budget.start(_completion.budget_ms);
+    if (_completion.network_idle_ms > 0 || _completion.dom_stable_ms > 0 || !_completion.predicate.empty()) {
+        _poll.start(std::max(_completion.poll_interval_ms, 1));
+    }
     mainFrame()->load(QUrl::fromUserInput(url));
 }
 
+bool WebPage::loading() const {
+    return _response != nullptr;
+}
+
 void WebPage::pageLoaded(bool ok) {
-    string& data = _response.setData();
-    data = mainFrame()->toHtml().toStdString();
-    _app.quit();
+    // 没有在加载，或者 finish 中 Stop 触发的通知
+    if (_response == nullptr) {
+        return;
+    }
+    if (!ok) {
+        finish(RenderCompletion::Failed);
+    } else if (!_poll.isActive()) {
+        finish(RenderCompletion::Loaded);
+    }
+    // 设置了其它结束条件时，loadFinished 之后脚本可能还在修改页面，继续等待
+}
+
+void WebPage::check() {
+    if (_response == nullptr) {
+        return;
+    }
+    if (!_completion.predicate.empty()
+        && mainFrame()->evaluateJavaScript(QString::fromStdString(_completion.predicate)).toBool()) {
+        finish(RenderCompletion::Predicate);
+        return;
+    }
+
+    NetworkAccessManager::NetworkState state = _nam->State(this);
+    if (!state.document_loaded) {
+        return;
+    }
+    if (_completion.network_idle_ms > 0) {
+        if (state.inflight > 0) {
+            _idle_since.invalidate();
+        } else if (!_idle_since.isValid()) {
+            _idle_since.start();
+        } else if (_idle_since.elapsed() >= _completion.network_idle_ms) {
+            finish(RenderCompletion::NetworkIdle);
+            return;
+        }
+    }
+    if (_completion.dom_stable_ms > 0) {
+        QString signature = mainFrame()->evaluateJavaScript(DOM_SIGNATURE).toString();
+        if (!_stable_since.isValid() || signature != _dom_signature) {
+            _dom_signature = signature;
+            _stable_since.start();
+        } else if (_stable_since.elapsed() >= _completion.dom_stable_ms) {
+            finish(RenderCompletion::DomStable);
+            return;
+        }
+    }
+}
+
+void WebPage::finish(RenderCompletion completion) {
+    if (_response == nullptr) {
+        return;
+    }
+    // 先解除绑定，Stop 触发的 loadFinished 被忽略，handler 中可以开始下一次加载
+    http::response::Response* response = _response;
+    LoadHandler handler;
+    handler.swap(_handler);
+    _response = nullptr;
+    _budget.stop();
+    _poll.stop();
+
+    if (completion != RenderCompletion::Loaded && completion != RenderCompletion::Failed) {
+        // 停止还在进行的请求和加载
+        triggerAction(QWebPage::Stop);
+    }
+    response->setData() = mainFrame()->toHtml().toStdString();
+    response->setCompletion(completion);
+    _nam->setResponse(this, nullptr);
+    handler(completion != RenderCompletion::Failed);
+}
+
+void apply_default_settings(QWebSettings* settings) {
+    settings->setAttribute(QWebSettings::PrivateBrowsingEnabled, true);
+    settings->setAttribute(QWebSettings::PluginsEnabled, false);
+    settings->setAttribute(QWebSettings::JavaEnabled, false);
+    settings->setAttribute(QWebSettings::AutoLoadImages, false);
+    settings->setAttribute(QWebSettings::DnsPrefetchEnabled, true);
+    settings->setAttribute(QWebSettings::DeveloperExtrasEnabled, true);
 }
 
 }}
@@ -3,29 +3,51 @@
 
 #include <iostream>
 #include <memory>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
 #include <QApplication>
 #include <QWebPage>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QWebFrame>
 #include <QWebElement>
+#include <QWebSettings>
 #include <QNetworkCookieJar>
 #include <QNetworkCookie>
 #include <QtCore>
 #include "request.h"
 #include "response.h"
+#include "resource_filter.h"
+#include "render_completion.h"
 
 namespace http {
 namespace qt_helper {
 
 /*
  * NetworkAccessManager
+ * 可以被多个 WebPage 共享，共享连接池和缓存；
+ * 把主文档的响应头记录到发起请求的页面绑定的 Response，
+ * 按 ResourceFilter 拦截子资源，统计记录到 Response::setResources()
  */
 class NetworkAccessManager: public QNetworkAccessManager {
 	Q_OBJECT
 
 public:
-    NetworkAccessManager(http::response::Response& response, QObject *parent = 0);
+    // 页面当前的网络状态，用于判断网络空闲
+    struct NetworkState {
+        // 进行中的请求数，包括主文档
+        int inflight = 0;
+        bool document_loaded = false;
+    };
+
+    NetworkAccessManager(QObject *parent = 0);
+
+    // 每次加载前绑定，nullptr 表示解除绑定
+    void setResponse(QWebPage* page, http::response::Response* response);
+    void setFilter(const ResourceFilter& filter);
+
+    NetworkState State(QWebPage* page) const;
 
 protected:
     QNetworkReply* createRequest(QNetworkAccessManager::Operation op,
@@ -35,32 +57,81 @@ private slots:
     void replyFinished(QNetworkReply *reply);
 
 private:
-    http::response::Response& _response;
+    struct Binding {
+        http::response::Response* response;
+        // 每次绑定都不同，忽略上一次加载遗留的请求
+        uint64_t generation;
+        NetworkState state;
+    };
+
+    // 发起请求的页面的绑定，不属于正在加载的页面时返回 nullptr
+    Binding* binding(const QNetworkRequest& req, bool& main_document);
+    // 发起请求时的绑定，已经重新绑定或解除时返回 nullptr
+    Binding* binding(QWebPage* page, uint64_t generation);
+    // 统计请求的进度和结束
+    void track(QNetworkReply* reply, QWebPage* page, uint64_t generation, bool main_document);
+
+    std::unordered_map<QWebPage*, Binding> _bindings;
+    uint64_t _generation;
+    ResourceMatcher _matcher;
 };
 
 /*
  * WebPage
+ *
+ * load 不阻塞，满足 CompletionOptions 的结束条件时回调，同一个事件循环中可以同时加载多个 WebPage；
+ * 一个 WebPage 同时只能加载一个页面，回调之后可以复用
  */
 class WebPage: public QWebPage {
 	Q_OBJECT
 
 public:
-    WebPage(QApplication& app,
-            http::response::Response& response,
-            QObject *parent = 0);
+    // ok 为 false 表示加载失败，结束条件见 Response::Completion()
+    typedef std::function<void(bool ok)> LoadHandler;
+
+    // nam 为 nullptr 时使用自己的 NetworkAccessManager，否则需要比 WebPage 活得久
+    WebPage(NetworkAccessManager* nam = nullptr, QObject *parent = 0);
+    ~WebPage();
 
-public slots:
-    void load(const QString& url);
+    /*
+     * 加载 url，结束时 response 中是主文档的响应头和渲染后的 html
+     * response 需要保持有效直到 handler 被调用
+     */
+    void load(const QString& url,
+              const http::render::CompletionOptions& completion,
+              http::response::Response& response,
+              LoadHandler handler);
+
+    bool loading() const;
 
 protected slots:
     void pageLoaded(bool ok);
 
 private:
-	std::unique_ptr<NetworkAccessManager> _nam;
-    QApplication& _app;
-    http::response::Response& _response;
+    // 检查 network idle、DOM stable 和 predicate
+    void check();
+    // 停止加载，以当前的内容结束
+    void finish(http::response::RenderCompletion completion);
+
+    std::unique_ptr<NetworkAccessManager> _own_nam;
+    NetworkAccessManager* _nam;
+    http::response::Response* _response;
+    LoadHandler _handler;
+
+    http::render::CompletionOptions _completion;
+    QTimer _budget;
+    QTimer _poll;
+    // 网络空闲、DOM 不变的开始时间
+    QElapsedTimer _idle_since;
+    QElapsedTimer _stable_since;
+    QString _dom_signature;
 };
 
+/*
+ * 渲染抓取使用的设置：隐私模式，不加载插件和图片
+ */
+void apply_default_settings(QWebSettings* settings);
+
 }}
 
 #endif
@@ -0,0 +1,31 @@
+#ifndef __HTTP_RENDER_COMPLETION_H__
+#define __HTTP_RENDER_COMPLETION_H__
+
+#include <string>
+
+namespace http {
+namespace render {
+
+/*
+ * 渲染的结束条件
+ *
+ * 没有设置 network_idle_ms、dom_stable_ms、predicate 时在 loadFinished 结束；
+ * 设置了任意一个时不再等待 loadFinished，满足其中一个即结束
+ * 超过 budget_ms 时停止加载，以已经渲染的内容结束
+ */
+struct CompletionOptions {
+    // 时间预算（毫秒）
+    int budget_ms = 2000;
+    // 主文档加载完成后，没有进行中的请求持续多久认为完成，0 表示不使用
+    int network_idle_ms = 0;
+    // 主文档加载完成后，DOM 多久没有变化认为完成，0 表示不使用
+    int dom_stable_ms = 0;
+    // 返回 true 时完成的 js 表达式，为空表示不使用
+    std::string predicate;
+    // 检查以上条件的间隔（毫秒）
+    int poll_interval_ms = 50;
+};
+
+}}
+
+#endif
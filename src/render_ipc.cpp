@@ -0,0 +1,209 @@
+#include "render_ipc.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+
+using namespace std;
+using http::response::Response;
+using http::response::ResourceStats;
+using http::response::RenderCompletion;
+
+namespace http {
+namespace render {
+
+// 单帧上限，超过说明数据错乱
+static const uint32_t MAX_FRAME = 256 << 20;
+
+static void put_uint64(string& out, uint64_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void put_string(string& out, const string& value) {
+    put_uint64(out, value.size());
+    out.append(value);
+}
+
+static void put_double(string& out, double value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/*
+ * 按顺序读取字段，越界时之后的读取都失败
+ */
+class FieldReader {
+public:
+    explicit FieldReader(const string& data) : _data(data), _pos(0) {}
+
+    bool get(uint64_t& value) {
+        return get_raw(&value, sizeof(value));
+    }
+
+    bool get(double& value) {
+        return get_raw(&value, sizeof(value));
+    }
+
+    bool get(string& value) {
+        uint64_t size = 0;
+        if (!get(size) || size > _data.size() - _pos) {
+            _pos = _data.size() + 1;
+            return false;
+        }
+        value.assign(_data, _pos, size);
+        _pos += size;
+        return true;
+    }
+
+    bool done() const {
+        return _pos == _data.size();
+    }
+
+private:
+    bool get_raw(void* value, size_t size) {
+        if (_pos > _data.size() || size > _data.size() - _pos) {
+            _pos = _data.size() + 1;
+            return false;
+        }
+        memcpy(value, _data.data() + _pos, size);
+        _pos += size;
+        return true;
+    }
+
+    const string& _data;
+    size_t _pos;
+};
+
+void encode_job(const RenderJob& job, string& out) {
+    out.clear();
+    put_uint64(out, job.id);
+    put_string(out, job.url);
+    put_uint64(out, static_cast<uint64_t>(job.completion.budget_ms));
+    put_uint64(out, static_cast<uint64_t>(job.completion.network_idle_ms));
+    put_uint64(out, static_cast<uint64_t>(job.completion.dom_stable_ms));
+    put_uint64(out, static_cast<uint64_t>(job.completion.poll_interval_ms));
+    put_string(out, job.completion.predicate);
+}
+
+bool decode_job(const string& data, RenderJob& job) {
+    FieldReader reader(data);
+    uint64_t budget_ms = 0, network_idle_ms = 0, dom_stable_ms = 0, poll_interval_ms = 0;
+    if (!reader.get(job.id) || !reader.get(job.url) || !reader.get(budget_ms)
+        || !reader.get(network_idle_ms) || !reader.get(dom_stable_ms) || !reader.get(poll_interval_ms)
+        || !reader.get(job.completion.predicate)) {
+        return false;
+    }
+    job.completion.budget_ms = static_cast<int>(budget_ms);
+    job.completion.network_idle_ms = static_cast<int>(network_idle_ms);
+    job.completion.dom_stable_ms = static_cast<int>(dom_stable_ms);
+    job.completion.poll_interval_ms = static_cast<int>(poll_interval_ms);
+    return reader.done();
+}
+
+void encode_result(const RenderResult& result, string& out) {
+    const Response& response = result.response;
+    out.clear();
+    put_uint64(out, result.id);
+    put_string(out, result.error);
+    put_double(out, result.elapsed_ms);
+    put_string(out, response.Protocol());
+    put_string(out, response.StatusCode());
+    put_string(out, response.StatusDescribe());
+    put_uint64(out, response.Headers().size());
+    for (const auto& header : response.Headers()) {
+        put_string(out, header.first);
+        put_string(out, header.second);
+    }
+    put_uint64(out, response.Resources().fetched);
+    put_uint64(out, response.Resources().cached);
+    put_uint64(out, response.Resources().blocked);
+    put_uint64(out, response.Resources().fetched_bytes);
+    put_uint64(out, static_cast<uint64_t>(response.Completion()));
+    put_string(out, response.Data());
+}
+
+bool decode_result(const string& data, RenderResult& result) {
+    FieldReader reader(data);
+    string protocol, status_code, status_describe;
+    uint64_t header_count = 0;
+    if (!reader.get(result.id) || !reader.get(result.error) || !reader.get(result.elapsed_ms)
+        || !reader.get(protocol) || !reader.get(status_code) || !reader.get(status_describe)
+        || !reader.get(header_count)) {
+        return false;
+    }
+
+    Response& response = result.response;
+    response.setProtocol(protocol);
+    response.setStatusCode(status_code);
+    response.setStatusDescribe(status_describe);
+    for (uint64_t i = 0; i < header_count; ++i) {
+        string key, value;
+        if (!reader.get(key) || !reader.get(value)) {
+            return false;
+        }
+        response.setHeader(key, value);
+    }
+    ResourceStats& resources = response.setResources();
+    uint64_t completion = 0;
+    if (!reader.get(resources.fetched) || !reader.get(resources.cached) || !reader.get(resources.blocked)
+        || !reader.get(resources.fetched_bytes) || !reader.get(completion)) {
+        return false;
+    }
+    response.setCompletion(static_cast<RenderCompletion>(completion));
+    return reader.get(response.setData()) && reader.done();
+}
+
+// fd 都是 unix socket，对端退出时返回错误而不是触发 SIGPIPE
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::read(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (n == 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool write_frame(int fd, const string& payload) {
+    if (payload.size() > MAX_FRAME) {
+        return false;
+    }
+    uint32_t size = payload.size();
+    // 每个 fd 只有一个写入方，长度和内容可以分开写
+    return write_all(fd, reinterpret_cast<const char*>(&size), sizeof(size))
+           && write_all(fd, payload.data(), payload.size());
+}
+
+bool read_frame(int fd, string& payload) {
+    uint32_t size = 0;
+    if (!read_all(fd, reinterpret_cast<char*>(&size), sizeof(size)) || size > MAX_FRAME) {
+        return false;
+    }
+    payload.resize(size);
+    return read_all(fd, &payload[0], size);
+}
+
+}}
@@ -0,0 +1,49 @@
+#ifndef __HTTP_RENDER_IPC_H__
+#define __HTTP_RENDER_IPC_H__
+
+#include <string>
+#include <cstdint>
+#include "response.h"
+#include "render_completion.h"
+
+namespace http {
+namespace render {
+
+/*
+ * RenderPool 与渲染进程之间的消息
+ *
+ * 帧格式：4 字节长度（本机字节序）+ 内容，
+ * 内容中整数为 8 字节（本机字节序），字符串为 8 字节长度 + 数据
+ */
+
+struct RenderJob {
+    uint64_t id = 0;
+    std::string url;
+    CompletionOptions completion;
+};
+
+struct RenderResult {
+    uint64_t id = 0;
+    // 为空表示成功
+    std::string error;
+    http::response::Response response;
+    // 渲染进程中从开始加载到返回结果的耗时（毫秒）
+    double elapsed_ms = 0;
+};
+
+void encode_job(const RenderJob& job, std::string& out);
+bool decode_job(const std::string& data, RenderJob& job);
+
+void encode_result(const RenderResult& result, std::string& out);
+bool decode_result(const std::string& data, RenderResult& result);
+
+/*
+ * 阻塞读写一帧，EINTR 时重试
+ * ret : 对端关闭或出错时返回 false
+ */
+bool write_frame(int fd, const std::string& payload);
+bool read_frame(int fd, std::string& payload);
+
+}}
+
+#endif
@@ -0,0 +1,444 @@
+#include "render_pool.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <future>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "render_ipc.h"
+#include "render_worker.h"
+
+using namespace std;
+using http::response::Response;
+
+namespace http {
+namespace render {
+
+// 渲染进程自己处理时间预算，超过 budget_ms 这么久还没有结果认为已经卡死
+static const int WORKER_GRACE_MS = 3000;
+
+static const char* WORKER_ERROR = "render worker error";
+
+/*
+ * 通过 unix socket 传递 fd，附带渲染进程的 pid
+ * fd 为 -1 表示创建失败
+ */
+static bool send_fd(int sock, int fd, pid_t pid) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    struct iovec iov;
+    iov.iov_base = &pid;
+    iov.iov_len = sizeof(pid);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    if (fd >= 0) {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == sizeof(pid);
+}
+
+static int recv_fd(int sock, pid_t& pid) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    struct iovec iov;
+    iov.iov_base = &pid;
+    iov.iov_len = sizeof(pid);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    char control[CMSG_SPACE(sizeof(int))];
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n != sizeof(pid)) {
+        return -1;
+    }
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+RenderPool::RenderPool(const RenderOptions& options)
+    : _options(options),
+      _zygote(-1),
+      _control(-1),
+      _next_id(0),
+      _stopping(false) {
+    if (_options.workers == 0) {
+        _options.workers = 1;
+    }
+    if (_options.pages_per_worker == 0) {
+        _options.pages_per_worker = 1;
+    }
+    if (_options.max_loads == 0) {
+        _options.max_loads = 1;
+    }
+    // 在 fork 之前检查正则，出错时在调用方抛出
+    http::qt_helper::ResourceMatcher matcher(_options.filter);
+
+    if (pipe2(_wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+        throw HttpException(string("render pool pipe error: ") + strerror(errno));
+    }
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        close(_wake[0]);
+        close(_wake[1]);
+        throw HttpException(string("render pool socketpair error: ") + strerror(errno));
+    }
+    _zygote = fork();
+    if (_zygote < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        close(_wake[0]);
+        close(_wake[1]);
+        throw HttpException(string("render pool fork error: ") + strerror(errno));
+    }
+    if (_zygote == 0) {
+        close(fds[0]);
+        zygote_main(fds[1], _options);
+    }
+    close(fds[1]);
+    _control = fds[0];
+
+    {
+        // 预先启动，第一次渲染不需要等待 WebKit 初始化
+        lock_guard<mutex> lock(_mutex);
+        _workers.resize(_options.workers);
+        for (size_t i = 0; i < _workers.size(); ++i) {
+            spawn(i);
+        }
+    }
+    _dispatcher = thread(&RenderPool::run_dispatcher, this);
+}
+
+RenderPool::~RenderPool() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stopping = true;
+    }
+    wake();
+    _dispatcher.join();
+
+    vector<Pending> failed;
+    for (auto& pending : _pending) {
+        failed.push_back(std::move(pending.second));
+    }
+    _pending.clear();
+    for (auto& pending : _queue) {
+        failed.push_back(std::move(pending));
+    }
+    _queue.clear();
+    for (auto& pending : failed) {
+        Response response;
+        pending.handler("render pool stopped", response);
+    }
+
+    // 渲染进程读到 EOF 后退出
+    for (auto& worker : _workers) {
+        if (worker.fd >= 0) {
+            close(worker.fd);
+            worker.fd = -1;
+        }
+    }
+    close(_wake[0]);
+    close(_wake[1]);
+    close(_control);
+    int status;
+    while (waitpid(_zygote, &status, 0) < 0 && errno == EINTR) {}
+}
+
+void RenderPool::zygote_main(int control, const RenderOptions& options) {
+    // 渲染进程退出后自动回收
+    signal(SIGCHLD, SIG_IGN);
+
+    // 父进程发送渲染进程的序号
+    uint32_t index;
+    while (true) {
+        ssize_t n = read(control, &index, sizeof(index));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n != sizeof(index)) {
+            break;
+        }
+
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+            send_fd(control, -1, -1);
+            continue;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(control);
+            close(fds[0]);
+            signal(SIGCHLD, SIG_DFL);
+            _exit(run_worker(fds[1], options, index));
+        }
+        close(fds[1]);
+        send_fd(control, pid < 0 ? -1 : fds[0], pid);
+        close(fds[0]);
+    }
+    _exit(0);
+}
+
+bool RenderPool::spawn(size_t index) {
+    uint32_t value = index;
+    if (write(_control, &value, sizeof(value)) != sizeof(value)) {
+        return false;
+    }
+    pid_t pid = -1;
+    int fd = recv_fd(_control, pid);
+    if (fd < 0) {
+        return false;
+    }
+    _workers[index].pid = pid;
+    _workers[index].fd = fd;
+    return true;
+}
+
+void RenderPool::wake() {
+    char c = 'w';
+    // 管道满时分发线程已经会被唤醒
+    ssize_t n = write(_wake[1], &c, 1);
+    (void)n;
+}
+
+void RenderPool::dispatch(vector<Pending>& failed) {
+    bool dispatched = false;
+    while (!_queue.empty()) {
+        size_t index = _workers.size();
+        for (size_t i = 0; i < _workers.size(); ++i) {
+            if (_workers[i].active < _options.pages_per_worker
+                && (index == _workers.size() || _workers[i].active < _workers[index].active)) {
+                index = i;
+            }
+        }
+        if (index == _workers.size()) {
+            break;
+        }
+
+        Worker& worker = _workers[index];
+        Pending pending = std::move(_queue.front());
+        _queue.pop_front();
+
+        // 出错后停掉的渲染进程在使用时重启
+        if (worker.fd < 0) {
+            ++_stats.restarts;
+            if (!spawn(index)) {
+                ++_stats.renders;
+                ++_stats.failures;
+                failed.push_back(std::move(pending));
+                continue;
+            }
+        }
+
+        // 每个渲染进程在途的任务帧不超过 pages_per_worker 个，不会写满 socket 缓冲区而阻塞
+        string frame;
+        encode_job(pending.job, frame);
+        if (!write_frame(worker.fd, frame)) {
+            // 渲染进程已经退出，由分发线程读到 EOF 后回收
+            kill(worker.pid, SIGKILL);
+        }
+        pending.worker = index;
+        pending.deadline = chrono::steady_clock::now()
+                           + chrono::milliseconds(pending.job.completion.budget_ms + WORKER_GRACE_MS);
+        ++worker.active;
+        uint64_t id = pending.job.id;
+        _pending.emplace(id, std::move(pending));
+        dispatched = true;
+    }
+    if (dispatched) {
+        wake();
+    }
+}
+
+void RenderPool::stop(size_t index, vector<Pending>& failed) {
+    Worker& worker = _workers[index];
+    if (worker.fd >= 0) {
+        close(worker.fd);
+        worker.fd = -1;
+    }
+    // 可能卡在页面脚本中，不会读到 EOF
+    if (worker.pid > 0) {
+        kill(worker.pid, SIGKILL);
+        worker.pid = -1;
+    }
+    worker.active = 0;
+
+    for (auto it = _pending.begin(); it != _pending.end();) {
+        if (it->second.worker == index) {
+            ++_stats.renders;
+            ++_stats.failures;
+            failed.push_back(std::move(it->second));
+            it = _pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void RenderPool::run_dispatcher() {
+    while (true) {
+        vector<struct pollfd> fds;
+        vector<size_t> indexes;
+        int timeout = -1;
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (_stopping) {
+                return;
+            }
+            struct pollfd pfd;
+            pfd.fd = _wake[0];
+            pfd.events = POLLIN;
+            fds.push_back(pfd);
+            // 只有分发线程关闭 fd，解锁后这些 fd 仍然有效
+            for (size_t i = 0; i < _workers.size(); ++i) {
+                if (_workers[i].fd >= 0) {
+                    pfd.fd = _workers[i].fd;
+                    fds.push_back(pfd);
+                    indexes.push_back(i);
+                }
+            }
+            auto now = chrono::steady_clock::now();
+            for (const auto& pending : _pending) {
+                auto left = chrono::duration_cast<chrono::milliseconds>(pending.second.deadline - now).count();
+                left = max<long long>(left + 1, 0);
+                if (timeout < 0 || left < timeout) {
+                    timeout = static_cast<int>(left);
+                }
+            }
+        }
+
+        int n;
+        do {
+            n = poll(fds.data(), fds.size(), timeout);
+        } while (n < 0 && errno == EINTR);
+
+        if (fds[0].revents & POLLIN) {
+            char buffer[64];
+            while (read(_wake[0], buffer, sizeof(buffer)) > 0) {}
+        }
+
+        // 在锁外读取，结果可能很大
+        vector<RenderResult> results;
+        vector<size_t> broken;
+        for (size_t i = 1; n > 0 && i < fds.size(); ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            string frame;
+            RenderResult result;
+            if (read_frame(fds[i].fd, frame) && decode_result(frame, result)) {
+                results.push_back(std::move(result));
+            } else {
+                broken.push_back(indexes[i - 1]);
+            }
+        }
+
+        vector<pair<Pending, RenderResult>> done;
+        vector<Pending> failed;
+        {
+            lock_guard<mutex> lock(_mutex);
+            for (auto& result : results) {
+                auto it = _pending.find(result.id);
+                if (it == _pending.end()) {
+                    continue;
+                }
+                --_workers[it->second.worker].active;
+                ++_stats.renders;
+                if (!result.error.empty()) {
+                    ++_stats.failures;
+                } else {
+                    _stats.subresources += result.response.Resources().fetched;
+                    _stats.cache_hits += result.response.Resources().cached;
+                    if (result.response.Completion() == http::response::RenderCompletion::Timeout) {
+                        ++_stats.timeouts;
+                    }
+                }
+                done.emplace_back(std::move(it->second), std::move(result));
+                _pending.erase(it);
+            }
+            for (size_t index : broken) {
+                stop(index, failed);
+            }
+
+            // 渲染进程自己的超时没有生效，整个进程已经卡住
+            auto now = chrono::steady_clock::now();
+            for (size_t i = 0; i < _workers.size(); ++i) {
+                for (const auto& pending : _pending) {
+                    if (pending.second.worker == i && pending.second.deadline <= now) {
+                        stop(i, failed);
+                        break;
+                    }
+                }
+            }
+            dispatch(failed);
+        }
+
+        for (auto& item : done) {
+            item.first.handler(item.second.error, item.second.response);
+        }
+        for (auto& pending : failed) {
+            Response response;
+            pending.handler(WORKER_ERROR, response);
+        }
+    }
+}
+
+void RenderPool::async_render(const string& url, const CompletionOptions& completion, RenderHandler handler) {
+    vector<Pending> failed;
+    {
+        lock_guard<mutex> lock(_mutex);
+        Pending pending;
+        pending.job.id = ++_next_id;
+        pending.job.url = url;
+        pending.job.completion = completion;
+        pending.handler = std::move(handler);
+        _queue.push_back(std::move(pending));
+        dispatch(failed);
+    }
+    for (auto& pending : failed) {
+        Response response;
+        pending.handler(WORKER_ERROR, response);
+    }
+}
+
+Response RenderPool::render(const string& url, const CompletionOptions& completion) {
+    promise<Response> result;
+    async_render(url, completion, [&result](const string& error, Response& response) {
+        if (error.empty()) {
+            result.set_value(std::move(response));
+        } else {
+            result.set_exception(make_exception_ptr(HttpException(error)));
+        }
+    });
+    return result.get_future().get();
+}
+
+RenderStats RenderPool::Stats() const {
+    lock_guard<mutex> lock(_mutex);
+    return _stats;
+}
+
+}}
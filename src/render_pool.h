@@ -0,0 +1,138 @@
+#ifndef __HTTP_RENDER_POOL_H__
+#define __HTTP_RENDER_POOL_H__
+
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <sys/types.h>
+#include "response.h"
+#include "render_ipc.h"
+#include "resource_filter.h"
+
+namespace http {
+namespace render {
+
+struct RenderOptions {
+    // 渲染进程数
+    size_t workers = 4;
+    // 每个渲染进程同时加载的页面数
+    size_t pages_per_worker = 16;
+    // 一个 WebPage 加载多少个页面后重建，限制 WebKit 的内存增长
+    size_t max_loads = 100;
+    // 渲染时拦截的子资源
+    http::qt_helper::ResourceFilter filter;
+    // 渲染进程内所有页面共享的内存缓存大小，0 表示不使用
+    size_t cache_memory_bytes = 32 << 20;
+    // 磁盘缓存目录，每个渲染进程使用其下的 worker-<序号> 子目录，重启后继续使用；为空时不使用
+    std::string cache_dir;
+    // 每个渲染进程的磁盘缓存大小
+    size_t cache_disk_bytes = 256 << 20;
+};
+
+struct RenderStats {
+    uint64_t renders = 0;
+    uint64_t failures = 0;
+    // 渲染进程退出或无响应后重启的次数
+    uint64_t restarts = 0;
+    // 成功渲染的页面的子资源请求数，以及其中从缓存读取的数量
+    uint64_t subresources = 0;
+    uint64_t cache_hits = 0;
+    // 超过时间预算结束的渲染
+    uint64_t timeouts = 0;
+};
+
+// error 为空表示成功
+typedef std::function<void(const std::string& error, http::response::Response& response)> RenderHandler;
+
+/*
+ * 常驻的渲染进程池，线程安全
+ *
+ * 每个渲染进程持有一个 QApplication 和多个可复用的 WebPage，省去每次渲染启动 WebKit 的开销，
+ * 请求通过 socketpair 发给在途任务最少的渲染进程，都满时排队
+ * 结果由内部的分发线程统一读取
+ *
+ * 渲染进程由构造时 fork 出的单线程 zygote 进程创建，
+ * fork 只复制调用线程，RenderPool 需要在启动其它线程之前创建
+ */
+class RenderPool {
+public:
+    explicit RenderPool(const RenderOptions& options = RenderOptions());
+    ~RenderPool();
+
+    /*
+     * func : 渲染页面，失败时抛出 HttpException
+     *
+     * completion : 结束条件和时间预算，超过预算时返回已经渲染的内容
+     *
+     * Response : 主文档的响应头，Data() 为渲染后的 html，Completion() 为结束渲染的条件
+     */
+    http::response::Response render(const std::string& url,
+                                    const CompletionOptions& completion = CompletionOptions());
+
+    /*
+     * func : 异步渲染页面
+     *
+     * handler : 在分发线程中回调，不能阻塞太久；创建渲染进程失败时在调用线程中直接回调
+     */
+    void async_render(const std::string& url, const CompletionOptions& completion, RenderHandler handler);
+
+    RenderStats Stats() const;
+
+private:
+    RenderPool(const RenderPool&);
+    RenderPool& operator=(const RenderPool&);
+
+    struct Worker {
+        pid_t pid = -1;
+        int fd = -1;
+        // 已发出还没有结果的任务数
+        size_t active = 0;
+    };
+
+    struct Pending {
+        RenderJob job;
+        RenderHandler handler;
+        std::chrono::steady_clock::time_point deadline;
+        size_t worker = 0;
+    };
+
+    // 通过 zygote 创建第 index 个渲染进程，需要持有锁
+    bool spawn(size_t index);
+    // 把排队的任务发给渲染进程，需要持有锁，创建渲染进程失败的任务放入 failed
+    void dispatch(std::vector<Pending>& failed);
+    // 结束渲染进程并取出它的全部任务，需要持有锁，只在分发线程中调用
+    void stop(size_t index, std::vector<Pending>& failed);
+    // 读取渲染结果，处理渲染进程退出和超时
+    void run_dispatcher();
+    void wake();
+    static void zygote_main(int control, const RenderOptions& options);
+
+    RenderOptions _options;
+    pid_t _zygote;
+    // 与 zygote 通信
+    int _control;
+
+    mutable std::mutex _mutex;
+    std::vector<Worker> _workers;
+    // 已发给渲染进程的任务
+    std::unordered_map<uint64_t, Pending> _pending;
+    // 渲染进程都满时排队
+    std::deque<Pending> _queue;
+    uint64_t _next_id;
+    RenderStats _stats;
+
+    std::thread _dispatcher;
+    // 唤醒分发线程，重新收集 fd 和超时时间
+    int _wake[2];
+    bool _stopping;
+};
+
+}}
+
+#endif
@@ -0,0 +1,127 @@
+#include "render_worker.h"
+
+using namespace std;
+using http::response::Response;
+using http::qt_helper::WebPage;
+
+namespace http {
+namespace render {
+
+static const char* LOAD_ERROR = "render load error";
+
+RenderWorker::RenderWorker(QApplication& app, int fd, const RenderOptions& options, size_t index)
+    : _app(app),
+      _fd(fd),
+      _options(options),
+      _cache(nullptr) {
+    _nam.reset(new http::qt_helper::NetworkAccessManager());
+    _nam->setFilter(_options.filter);
+
+    QString directory;
+    if (!_options.cache_dir.empty()) {
+        directory = QString::fromStdString(_options.cache_dir + "/worker-" + to_string(index));
+    }
+    if (_options.cache_memory_bytes > 0 || !directory.isEmpty()) {
+        _cache = new http::qt_helper::NetworkCache(_options.cache_memory_bytes, _options.cache_disk_bytes, directory);
+        // QNetworkAccessManager 接管缓存的释放
+        _nam->setCache(_cache);
+    }
+}
+
+void RenderWorker::start() {
+    _notifier.reset(new QSocketNotifier(_fd, QSocketNotifier::Read));
+    QObject::connect(_notifier.get(), &QSocketNotifier::activated, [this](int) { read_job(); });
+}
+
+void RenderWorker::new_page(Slot& slot) {
+    if (slot.page != nullptr) {
+        // 可能在该页面自己的回调中，延后释放
+        slot.page.release()->deleteLater();
+        // 释放已经关闭的页面占用的缓存
+        QWebSettings::clearMemoryCaches();
+    }
+    slot.page.reset(new WebPage(_nam.get()));
+    http::qt_helper::apply_default_settings(slot.page->settings());
+    slot.loads = 0;
+}
+
+void RenderWorker::read_job() {
+    // 父进程一次写出整帧，可以阻塞读取
+    string frame;
+    RenderJob job;
+    if (!read_frame(_fd, frame) || !decode_job(frame, job)) {
+        _notifier->setEnabled(false);
+        _app.quit();
+        return;
+    }
+
+    for (auto& slot : _slots) {
+        if (!slot->busy) {
+            start_job(*slot, job);
+            return;
+        }
+    }
+    if (_slots.size() < _options.pages_per_worker) {
+        Slot* slot = new Slot();
+        _slots.push_back(unique_ptr<Slot>(slot));
+        new_page(*slot);
+        start_job(*slot, job);
+        return;
+    }
+    _queue.push_back(job);
+}
+
+void RenderWorker::start_job(Slot& slot, const RenderJob& job) {
+    slot.busy = true;
+    slot.job_id = job.id;
+    slot.response = Response();
+    slot.elapsed.start();
+
+    Slot* s = &slot;
+    slot.page->load(QString::fromStdString(job.url), job.completion, slot.response,
+                    [this, s](bool ok) { finish_job(*s, ok); });
+}
+
+void RenderWorker::finish_job(Slot& slot, bool ok) {
+    RenderResult result;
+    result.id = slot.job_id;
+    // 父进程按 error 计入 RenderStats::failures
+    if (!ok) {
+        result.error = LOAD_ERROR;
+    }
+    result.response = std::move(slot.response);
+    result.elapsed_ms = slot.elapsed.elapsed();
+    slot.busy = false;
+
+    string frame;
+    encode_result(result, frame);
+    if (!write_frame(_fd, frame)) {
+        _app.quit();
+        return;
+    }
+
+    if (++slot.loads >= _options.max_loads) {
+        new_page(slot);
+    }
+    if (!_queue.empty()) {
+        RenderJob job = _queue.front();
+        _queue.pop_front();
+        start_job(slot, job);
+    }
+}
+
+int run_worker(int fd, const RenderOptions& options, size_t index) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    int argc = 1;
+    char name[] = "render_worker";
+    char* argv[] = {name, nullptr};
+    QApplication app(argc, argv);
+
+    RenderWorker worker(app, fd, options, index);
+    worker.start();
+    app.exec();
+    return 0;
+}
+
+}}
@@ -0,0 +1,72 @@
+#ifndef __HTTP_RENDER_WORKER_H__
+#define __HTTP_RENDER_WORKER_H__
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include <QApplication>
+#include <QSocketNotifier>
+#include <QElapsedTimer>
+#include "qt_webkit_helper.h"
+#include "network_cache.h"
+#include "render_ipc.h"
+#include "render_pool.h"
+
+namespace http {
+namespace render {
+
+/*
+ * 渲染进程
+ *
+ * 在 QApplication 的事件循环中读取 RenderJob，最多 pages_per_worker 个 WebPage 同时加载，
+ * 每个页面结束时把结果写回 fd；WebPage 加载 max_loads 次后重建
+ * 所有 WebPage 共享一个 NetworkAccessManager，跨页面复用连接和缓存
+ */
+class RenderWorker {
+public:
+    // index 为渲染进程的序号，用于区分磁盘缓存目录
+    RenderWorker(QApplication& app, int fd, const RenderOptions& options, size_t index);
+
+    // 开始读取任务，对端关闭后退出事件循环
+    void start();
+
+private:
+    struct Slot {
+        std::unique_ptr<http::qt_helper::WebPage> page;
+        http::response::Response response;
+        uint64_t job_id = 0;
+        QElapsedTimer elapsed;
+        size_t loads = 0;
+        bool busy = false;
+    };
+
+    void read_job();
+    void start_job(Slot& slot, const RenderJob& job);
+    // ok 为 false 表示页面加载失败
+    void finish_job(Slot& slot, bool ok);
+    void new_page(Slot& slot);
+
+    QApplication& _app;
+    int _fd;
+    RenderOptions _options;
+
+    // 需要在所有 WebPage 之后析构
+    std::unique_ptr<http::qt_helper::NetworkAccessManager> _nam;
+    // 由 _nam 持有
+    http::qt_helper::NetworkCache* _cache;
+
+    std::unique_ptr<QSocketNotifier> _notifier;
+    // Slot 的地址在回调中使用，不能移动
+    std::vector<std::unique_ptr<Slot>> _slots;
+    // 没有空闲 WebPage 时排队
+    std::deque<RenderJob> _queue;
+};
+
+/*
+ * 渲染进程入口，在 fork 出的子进程中调用
+ */
+int run_worker(int fd, const RenderOptions& options, size_t index);
+
+}}
+
+#endif
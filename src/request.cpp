@@ -4,6 +4,14 @@
 */
 
 #include "request.h"
+#include "multipart_parser.h"
+#include "form_params.h"
+#include "json_extractor.h"
+
+using http::multipart::MultipartParser;
+using http::multipart::MultipartForm;
+using http::form::FormParams;
+using http::json::JsonExtractor;
 
 namespace http {  
 namespace request {    
@@ -20,20 +28,28 @@ string Request::to_string() const {
 }
 
 bool Request::post_extract_json(const string& data, std::map<string, string>& ret) {
-    Json json = Json::parse(data);
+    Json json = Json::parse(data, nullptr, false);
+    if (json.is_discarded() || !json.is_object()) {
+        return false;
+    }
     for (Json::iterator it = json.begin(); it != json.end(); ++it) {
-        ret[it.key()] = it.value();
+        ret[it.key()] = it.value().is_string() ? it.value().get<string>() : it.value().dump();
     }
     return true;
 }
 
+bool Request::post_extract_json(const string& data,
+                                const vector<string>& fields,
+                                std::map<string, string>& ret) {
+    JsonExtractor extractor(fields, ret);
+    return extractor.extract(data);
+}
+
 bool Request::post_extract_get(const string& data, unordered_map<string, string>& ret) {
-    vector<string> lines;
-    boost::split(lines, data, boost::is_any_of("&"));
-    for (const auto& line : lines) {
-        vector<string> kv;
-        boost::split(kv, line, boost::is_any_of("="));
-        ret[kv[0]] = kv[1];
+    FormParams params;
+    FormParams::parse(data, params);
+    for (const auto& item : params) {
+        ret[item.first] = item.second;
     }
 
     return true;
@@ -42,78 +58,39 @@ bool Request::post_extract_get(const string& data, unordered_map<string, string>
 bool Request::post_extract_multipart(const string& content_type,
                                      const string& data,
                                      unordered_map<string, string>& ret) {
-    vector<string> st;
-    boost::split(st, content_type, boost::is_any_of("="));
-    if (st.size() != 2) { return false; }
-
-    string boundary = st[1];
-    boundary = "--" + boundary;
-    st.clear();
-    boost::split(st, data, boost::is_any_of(boundary));
-
-    // split by boundary
-    for (const auto& i : st) {
-        // split by /r/n/r/n
-        vector<string> i_ret;
-        boost::split(i_ret, i, boost::is_any_of("\r\n\r\n"));
-        for (int l = 0; l < i_ret.size()-1; ++l) {
-            const auto &j = i_ret[l];
-            // split by \r\n
-            vector<string> j_ret;
-            boost::split(j_ret, j, boost::is_any_of("\r\n"));
-            for (const auto& k : j_ret) {
-                // split by ;
-                vector<string> k_ret;
-                boost::split(k_ret, k, boost::is_any_of(";"));
-                for (const auto& m : k_ret) {
-                    vector<string> r;
-                    boost::split(r, m, boost::is_any_of(":"));
-                    if (r.size() == 1) {
-                        r.clear();
-                        boost::split(r, m, boost::is_any_of("="));
-                    }
-                    if (r.size() != 1) {
-                        string key = boost::trim_copy(r[0]);
-                        string val = boost::trim_copy(r[1]);
-                        
-                        val.erase(0,val.find_first_not_of("\""));
-                        val.erase(val.find_last_not_of("\"") + 1);
-
-                        ret[key] = val;
-                        if (key == "name") {
-                            ret[val] = boost::trim_copy(i_ret.back());
-                        }
-                    }
-                }
-            }
-        }
+    string boundary;
+    if (!MultipartParser::extract_boundary(content_type, boundary)) {
+        return false;
     }
 
+    MultipartForm form(boundary);
+    form.feed(data.data(), data.size());
+    if (!form.done()) {
+        return false;
+    }
+
+    for (const auto& field : form.fields()) {
+        ret[field.first] = field.second;
+    }
     return true;
 }
 
 void Request::extract_header(const string& request_message, const string& key, string& value){
     string result = boost::algorithm::to_lower_copy(request_message);
-    size_t spos = result.find(key);
+    // 只匹配行首的 header 名
+    size_t spos = result.find(CRLF + key + ":");
     if (spos == string::npos) {
         return;
     }
+    spos += CRLF.size() + key.size() + 1;
 
-    size_t epos = result.find("\r\n", spos);
+    size_t epos = result.find(CRLF, spos);
     if (epos == string::npos) {
         return;
     }
 
-    string kv = result.substr(spos, epos-spos);
-
-    size_t pos;
-    while (kv.length() > 0 && (pos = kv.find(" ")) != string::npos) {
-        kv.erase(pos, 1);    
-    }
-
-    vector<string> strs;
-    boost::split(strs, kv, boost::is_any_of(":"));
-    value = strs[1];
+    // value 保留原始大小写，例如 multipart 的 boundary
+    value = boost::trim_copy(request_message.substr(spos, epos-spos));
 }
 
 void Request::extract_request_line(const string& request_message, unordered_map<string, string>& result){
@@ -124,6 +101,10 @@ void Request::extract_request_line(const string& request_message, unordered_map<
     string req_line = request_message.substr(0, pos);
     vector<string> strs;
     boost::split(strs, req_line, boost::is_any_of(" "));
+    // 格式不对时 url 为空，由 server 拒绝
+    if (strs.size() != 3) {
+        return;
+    }
     result["method"] = strs[0];
     result["url"] = strs[1];
     result["protocol"] = strs[2];
@@ -148,29 +129,13 @@ void Request::extract_request(const string& request){
 }
 
 void Request::parse_url() {
-    // 去掉协议头
-    size_t pos = _url.find("http://");
-    if (pos == 0) {
-        _url = _url.substr(7);
-    }
-    pos = _url.find("https://");
-    if (pos == 0) {
-        _url = _url.substr(8);
-    }
-
-    // 去掉host
-    pos = _url.find("/");
-    _url = _url.substr(pos);
-
-    // 去掉参数
-    pos = _url.find("?");
-    if (pos != string::npos) {
-        _data = _url.substr(pos+1);
-        _url = _url.substr(0, pos);
+    // 请求行格式不对时 url 为空，不能按 "/" 处理
+    if (_url.empty()) {
+        return;
     }
-
-    // 转小写
-    boost::to_lower(_url);
+    // 非法的 path 置空，由 server 拒绝
+    _target.parse(_url);
+    _url = _target.Path();
 }
 
 void Request::setMethod(const string& method) { 
@@ -219,6 +184,18 @@ const string& Request::Data() const {
     return _data; 
 }
 
+const string& Request::Query() const {
+    return _target.Query();
+}
+
+const string* Request::Param(const string& key) const {
+    return _target.Param(key);
+}
+
+const http::url::Url& Request::Target() const {
+    return _target;
+}
+
 void Request::printHeaders() {
     for (auto it = _headers.begin(); it != _headers.end(); ++it) {
         cout << it->first << ":" << it->second << endl;
@@ -7,6 +7,7 @@
 #define __HTTP_HTTPSERVER_REQUEST__
 
 #include "http_common.h"
+#include "url.h"
 
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -52,6 +53,9 @@ private:
     string _url;
     string _protocol;
 
+    // 解析后的 request-target
+    http::url::Url _target;
+
     // 请求头
     unordered_map<string, string> _headers;
 
@@ -64,7 +68,8 @@ public:
      * 功能 : 解析post请求体数据
      * post种类 : application/x-www-form-urlencoded
      * data : 请求体
-     * ret  : 解析结果
+     * ret  : 解析结果，已 urldecode，同名参数取最后一个
+     * 需要保留同名参数请使用 form::FormParams::parse
      */
     static bool post_extract_get(const string& data,
                              unordered_map<string, string>& ret);
@@ -73,17 +78,29 @@ public:
      * 功能 : 解析post请求体数据
      * post种类 : json
      * data : 请求体
-     * ret  : 解析结果
+     * ret  : 解析结果，字符串为原始内容，其它类型为 json 文本
      */
     static bool post_extract_json(const string& data,
                                   std::map<string, string>& ret);
 
+    /*
+     * 功能 : 按需解析post请求体数据，只提取需要的字段，不构建整个 DOM
+     * post种类 : json
+     * data : 请求体
+     * fields : 字段路径，例如 "user.name"、"items.0.id"
+     * ret  : 字段路径 -> 值，字符串为原始内容，其它类型为 json 文本
+     */
+    static bool post_extract_json(const string& data,
+                                  const vector<string>& fields,
+                                  std::map<string, string>& ret);
+
     /*
      * 功能 : 解析post请求体数据
      * post种类 : multipart/form-data
      * content_type : content-type header
      * data : 请求体
-     * ret  : 解析结果
+     * ret  : 解析结果，字段名 -> 字段内容
+     * 大文件上传请在 HttpServer::body_sink 中使用 multipart::MultipartForm 直接落盘
      */
     static bool post_extract_multipart(const string& content_type,
                                        const string& data,
@@ -109,7 +126,8 @@ protected:
      */
     void extract_request_line(const string& request_message, unordered_map<string, string>& result);
     /*
-     * 后处理url，去掉 协议后、host、参数、转小写
+     * 后处理url，去掉 协议头、host、参数，path 解码并规范化
+     * query 单独保存在 _target 中，不再写入 _data
      */
     void parse_url();
 
@@ -126,6 +144,12 @@ public:
     const string& Protocol() const;
     const string& Header(const string& key);
     const string& Data() const;
+
+    // 原始 query string
+    const string& Query() const;
+    // query 参数，第一次访问时解析
+    const string* Param(const string& key) const;
+    const http::url::Url& Target() const;
     
     void printHeaders();
 };
@@ -0,0 +1,100 @@
+#include "resource_filter.h"
+
+#include <boost/algorithm/string.hpp>
+#include "http_common.h"
+
+using namespace std;
+using http::common::HttpException;
+
+namespace http {
+namespace qt_helper {
+
+static const set<string> SCRIPT_EXTENSIONS = {"js", "mjs"};
+static const set<string> STYLESHEET_EXTENSIONS = {"css"};
+static const set<string> IMAGE_EXTENSIONS = {"png", "jpg", "jpeg", "gif", "webp", "svg", "ico", "bmp", "avif"};
+static const set<string> FONT_EXTENSIONS = {"woff", "woff2", "ttf", "otf", "eot"};
+static const set<string> MEDIA_EXTENSIONS = {"mp4", "webm", "ogg", "ogv", "mp3", "wav", "m4a", "m3u8", "flv"};
+
+ResourceType resource_type(const string& path, const string& accept) {
+    // WebKit 按请求的用途设置 Accept，优先使用
+    if (boost::algorithm::starts_with(accept, "text/html")) {
+        return ResourceType::Document;
+    }
+    if (boost::algorithm::starts_with(accept, "text/css")) {
+        return ResourceType::Stylesheet;
+    }
+    if (boost::algorithm::starts_with(accept, "image/")) {
+        return ResourceType::Image;
+    }
+
+    size_t slash = path.rfind('/');
+    size_t dot = path.rfind('.');
+    if (dot == string::npos || (slash != string::npos && dot < slash)) {
+        return ResourceType::Other;
+    }
+    string extension = boost::algorithm::to_lower_copy(path.substr(dot + 1));
+    if (SCRIPT_EXTENSIONS.count(extension)) {
+        return ResourceType::Script;
+    }
+    if (STYLESHEET_EXTENSIONS.count(extension)) {
+        return ResourceType::Stylesheet;
+    }
+    if (IMAGE_EXTENSIONS.count(extension)) {
+        return ResourceType::Image;
+    }
+    if (FONT_EXTENSIONS.count(extension)) {
+        return ResourceType::Font;
+    }
+    if (MEDIA_EXTENSIONS.count(extension)) {
+        return ResourceType::Media;
+    }
+    return ResourceType::Other;
+}
+
+// host 等于 domain 或者是它的子域名
+static bool match_domain(const string& host, const vector<string>& domains) {
+    for (const auto& domain : domains) {
+        if (host.size() == domain.size()) {
+            if (boost::algorithm::iequals(host, domain)) {
+                return true;
+            }
+        } else if (host.size() > domain.size() && host[host.size() - domain.size() - 1] == '.'
+                   && boost::algorithm::iends_with(host, domain)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ResourceMatcher::ResourceMatcher(const ResourceFilter& filter)
+    : _filter(filter) {
+    for (const auto& pattern : _filter.block_patterns) {
+        try {
+            _patterns.emplace_back(pattern, regex::ECMAScript | regex::optimize);
+        } catch (const regex_error& ex) {
+            throw HttpException("invalid block pattern: " + pattern);
+        }
+    }
+}
+
+bool ResourceMatcher::block(const string& url, const string& host, ResourceType type) const {
+    if (!host.empty()) {
+        if (match_domain(host, _filter.deny_domains)) {
+            return true;
+        }
+        if (!_filter.allow_domains.empty() && !match_domain(host, _filter.allow_domains)) {
+            return true;
+        }
+    }
+    if (_filter.block_types.count(type)) {
+        return true;
+    }
+    for (const auto& pattern : _patterns) {
+        if (regex_search(url, pattern)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}}
@@ -0,0 +1,60 @@
+#ifndef __HTTP_RESOURCE_FILTER_H__
+#define __HTTP_RESOURCE_FILTER_H__
+
+#include <set>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace http {
+namespace qt_helper {
+
+enum class ResourceType {
+    Document,
+    Script,
+    Stylesheet,
+    Image,
+    Font,
+    Media,
+    // xhr 等无法判断类型的请求
+    Other
+};
+
+/*
+ * 根据 url 路径的扩展名和 WebKit 发出的 Accept 头判断资源类型
+ */
+ResourceType resource_type(const std::string& path, const std::string& accept);
+
+/*
+ * 渲染时拦截的子资源，主文档总是放行
+ * 依次检查：deny_domains、allow_domains、block_types、block_patterns
+ */
+struct ResourceFilter {
+    // 拦截的资源类型
+    std::set<ResourceType> block_types = {ResourceType::Font, ResourceType::Media};
+    // url 匹配任意一个正则时拦截，例如广告、统计脚本
+    std::vector<std::string> block_patterns;
+    // 不为空时只放行这些域名及其子域名
+    std::vector<std::string> allow_domains;
+    // 拦截这些域名及其子域名
+    std::vector<std::string> deny_domains;
+};
+
+/*
+ * 预先编译 block_patterns，正则有误时抛出 HttpException
+ */
+class ResourceMatcher {
+public:
+    explicit ResourceMatcher(const ResourceFilter& filter = ResourceFilter());
+
+    // host 为空（如 file、data）时不检查域名
+    bool block(const std::string& url, const std::string& host, ResourceType type) const;
+
+private:
+    ResourceFilter _filter;
+    std::vector<std::regex> _patterns;
+};
+
+}}
+
+#endif
@@ -39,6 +39,30 @@ string& Response::setData() {
     return _data;
 }
 
+void Response::setTiming(const TimingInfo& timing) {
+    _timing = timing;
+}
+
+TimingInfo& Response::setTiming() {
+    return _timing;
+}
+
+void Response::setRedirects(const vector<RedirectHop>& redirects) {
+    _redirects = redirects;
+}
+
+void Response::setResources(const ResourceStats& resources) {
+    _resources = resources;
+}
+
+ResourceStats& Response::setResources() {
+    return _resources;
+}
+
+void Response::setCompletion(RenderCompletion completion) {
+    _completion = completion;
+}
+
 const string& Response::Protocol() const {
     return _protocol;
 }
@@ -56,8 +80,28 @@ const string& Response::Header(const string& key) {
     return _headers[tmp_key];
 }
 
+const unordered_map<string, string>& Response::Headers() const {
+    return _headers;
+}
+
 const string& Response::Data() const {
     return _data;
 }
 
+const TimingInfo& Response::Timing() const {
+    return _timing;
+}
+
+const vector<RedirectHop>& Response::Redirects() const {
+    return _redirects;
+}
+
+const ResourceStats& Response::Resources() const {
+    return _resources;
+}
+
+RenderCompletion Response::Completion() const {
+    return _completion;
+}
+
 }}
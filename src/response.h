@@ -9,6 +9,7 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <cstdint>
 #include <unordered_map>
 
 using std::string;
@@ -23,6 +24,66 @@ using namespace http::common;
 namespace http {
 namespace response {    
 
+/*
+ * 客户端请求各阶段耗时（毫秒）
+ * 复用连接时没有 dns、connect、tls 阶段，值为 -1
+ */
+struct TimingInfo {
+    // 等待连接池名额
+    double queue = 0;
+    double dns = -1;
+    double connect = -1;
+    double tls = -1;
+    // 新建的 https 连接复用了 TLS 会话
+    bool tls_resumed = false;
+    // 开始发送请求到收到第一个字节
+    double ttfb = -1;
+    // 整个请求，从发起到包体接收完成
+    double total = 0;
+    bool reused = false;
+};
+
+/*
+ * 客户端跟随的一次跳转
+ */
+struct RedirectHop {
+    string url;
+    string status_code;
+    string location;
+    // 该跳的耗时，total 为该跳从发起到响应结束
+    TimingInfo timing;
+};
+
+/*
+ * 渲染时子资源的请求统计，不包括主文档
+ */
+struct ResourceStats {
+    uint64_t fetched = 0;
+    // fetched 中从缓存读取的请求数
+    uint64_t cached = 0;
+    // 被 ResourceFilter 拦截的请求数
+    uint64_t blocked = 0;
+    // 放行的请求已接收的字节数
+    uint64_t fetched_bytes = 0;
+};
+
+/*
+ * 结束渲染的条件
+ */
+enum class RenderCompletion {
+    // 不是渲染的响应
+    None,
+    // loadFinished
+    Loaded,
+    NetworkIdle,
+    DomStable,
+    Predicate,
+    // 超过时间预算，内容可能不完整
+    Timeout,
+    // 加载失败
+    Failed
+};
+
 class Response {
 private:
     // 状态行
@@ -36,6 +97,18 @@ private:
     // 响应体
     string _data;
 
+    // 客户端请求耗时
+    TimingInfo _timing;
+
+    // 客户端跟随的跳转，按顺序排列，不包括最终的响应
+    vector<RedirectHop> _redirects;
+
+    // 渲染时子资源的请求统计
+    ResourceStats _resources;
+
+    // 结束渲染的条件
+    RenderCompletion _completion = RenderCompletion::None;
+
 public:
     /*
      * 生成响应报文文本
@@ -49,12 +122,23 @@ public:
     void setHeader(const string& key, const string& val);
     void setData(const string& data);
     string& setData();
+    void setTiming(const TimingInfo& timing);
+    TimingInfo& setTiming();
+    void setRedirects(const vector<RedirectHop>& redirects);
+    void setResources(const ResourceStats& resources);
+    ResourceStats& setResources();
+    void setCompletion(RenderCompletion completion);
 
     const string& Protocol() const;
     const string& StatusCode() const;
     const string& StatusDescribe() const;
     const string& Header(const string& key);
+    const unordered_map<string, string>& Headers() const;
     const string& Data() const ;
+    const TimingInfo& Timing() const;
+    const vector<RedirectHop>& Redirects() const;
+    const ResourceStats& Resources() const;
+    RenderCompletion Completion() const;
     
 };
 
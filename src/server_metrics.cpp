@@ -0,0 +1,249 @@
+#include "server_metrics.h"
+
+#include <cstdio>
+
+using namespace std;
+
+namespace http {
+namespace metrics {
+
+static const char* STAGE_NAMES[STAGE_COUNT] = {
+    "accept_to_first_byte", "parse", "handler", "write"
+};
+
+// 导出的 histogram 桶上界（微秒）
+static const uint64_t EXPORT_BUCKETS_US[] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+static const double EXPORT_QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+static atomic<uint64_t> g_next_id(1);
+
+// 只有所属线程写，不需要原子的读-改-写
+static inline void bump(atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::bucket_index(uint64_t value) {
+    if (value < 32) {
+        return static_cast<size_t>(value);
+    }
+    if (value > MAX_VALUE) {
+        value = MAX_VALUE;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - 4;
+    size_t mantissa = static_cast<size_t>(value >> shift);
+    return 32 + (msb - 5) * 16 + (mantissa - 16);
+}
+
+uint64_t LatencyHistogram::bucket_upper(size_t index) {
+    if (index < 32) {
+        return index;
+    }
+    int msb = static_cast<int>((index - 32) / 16) + 5;
+    uint64_t mantissa = (index - 32) % 16 + 16;
+    return ((mantissa + 1) << (msb - 4)) - 1;
+}
+
+LatencyHistogram::LatencyHistogram() : _count(0), _sum(0) {
+    for (auto& bucket : _buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    bump(_buckets[bucket_index(value)], 1);
+    bump(_count, 1);
+    bump(_sum, value);
+}
+
+uint64_t LatencyHistogram::merge_into(vector<uint64_t>& buckets, uint64_t& sum) const {
+    // 与 record 并发时各个值之间可能相差几个记录，不影响导出
+    uint64_t count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        uint64_t value = _buckets[i].load(std::memory_order_relaxed);
+        buckets[i] += value;
+        count += value;
+    }
+    sum += _sum.load(std::memory_order_relaxed);
+    return count;
+}
+
+uint64_t HistogramSnapshot::count_le(uint64_t value) const {
+    // value 所在的桶可能包含大于 value 的记录，不计入
+    uint64_t total = 0;
+    for (size_t i = 0; i < buckets.size() && LatencyHistogram::bucket_upper(i) <= value; ++i) {
+        total += buckets[i];
+    }
+    return total;
+}
+
+uint64_t HistogramSnapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * count);
+    if (rank >= count) {
+        rank = count - 1;
+    }
+    uint64_t total = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        total += buckets[i];
+        if (total > rank) {
+            return LatencyHistogram::bucket_upper(i);
+        }
+    }
+    return LatencyHistogram::bucket_upper(buckets.size() - 1);
+}
+
+struct ServerMetrics::ThreadMetrics {
+    ThreadMetrics() : connections(0), closed(0), requests(0), bytes_in(0), bytes_out(0) {
+        for (auto& counter : status) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    atomic<uint64_t> connections;
+    // 可能在另一个线程关闭，与 connections 分开计数
+    atomic<uint64_t> closed;
+    atomic<uint64_t> requests;
+    atomic<uint64_t> bytes_in;
+    atomic<uint64_t> bytes_out;
+    atomic<uint64_t> status[MAX_STATUS];
+    LatencyHistogram stages[STAGE_COUNT];
+    // 与相邻分配的其它线程的数据不共享缓存行
+    char padding[64];
+};
+
+ServerMetrics::ServerMetrics() : _id(g_next_id.fetch_add(1)) {
+}
+
+ServerMetrics::~ServerMetrics() {
+}
+
+ServerMetrics::ThreadMetrics& ServerMetrics::local() {
+    // 每个线程记住自己在各个实例中的数据，一般只有一个实例
+    static thread_local vector<pair<uint64_t, ThreadMetrics*>> cache;
+    for (auto& entry : cache) {
+        if (entry.first == _id) {
+            return *entry.second;
+        }
+    }
+
+    unique_ptr<ThreadMetrics> metrics(new ThreadMetrics);
+    ThreadMetrics* result = metrics.get();
+    {
+        lock_guard<mutex> lock(_mutex);
+        _threads.push_back(std::move(metrics));
+    }
+    cache.emplace_back(_id, result);
+    return *result;
+}
+
+void ServerMetrics::connection_opened() {
+    bump(local().connections, 1);
+}
+
+void ServerMetrics::connection_closed() {
+    bump(local().closed, 1);
+}
+
+void ServerMetrics::add_bytes_in(uint64_t bytes) {
+    bump(local().bytes_in, bytes);
+}
+
+void ServerMetrics::record_stage(Stage stage, uint64_t latency_us) {
+    local().stages[static_cast<int>(stage)].record(latency_us);
+}
+
+void ServerMetrics::record_response(int status, uint64_t bytes_out) {
+    ThreadMetrics& metrics = local();
+    bump(metrics.requests, 1);
+    bump(metrics.bytes_out, bytes_out);
+    bump(metrics.status[status > 0 && status < MAX_STATUS ? status : 0], 1);
+}
+
+MetricsSnapshot ServerMetrics::Snapshot() const {
+    MetricsSnapshot snapshot;
+    snapshot.status.assign(MAX_STATUS, 0);
+    uint64_t closed = 0;
+
+    lock_guard<mutex> lock(_mutex);
+    for (auto& metrics : _threads) {
+        snapshot.connections += metrics->connections.load(std::memory_order_relaxed);
+        closed += metrics->closed.load(std::memory_order_relaxed);
+        snapshot.requests += metrics->requests.load(std::memory_order_relaxed);
+        snapshot.bytes_in += metrics->bytes_in.load(std::memory_order_relaxed);
+        snapshot.bytes_out += metrics->bytes_out.load(std::memory_order_relaxed);
+        for (int i = 0; i < MAX_STATUS; ++i) {
+            snapshot.status[i] += metrics->status[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < STAGE_COUNT; ++i) {
+            HistogramSnapshot& stage = snapshot.stages[i];
+            stage.count += metrics->stages[i].merge_into(stage.buckets, stage.sum);
+        }
+    }
+    snapshot.active_connections = snapshot.connections > closed ? snapshot.connections - closed : 0;
+    return snapshot;
+}
+
+static void append_metric(string& out, const char* name, const char* type, const char* help, uint64_t value) {
+    out += string("# HELP ") + name + " " + help + "\n";
+    out += string("# TYPE ") + name + " " + type + "\n";
+    out += string(name) + " " + to_string(value) + "\n";
+}
+
+static string seconds(uint64_t us) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.6f", us / 1e6);
+    return buffer;
+}
+
+void ServerMetrics::write_prometheus(string& out) const {
+    MetricsSnapshot snapshot = Snapshot();
+
+    append_metric(out, "http_server_connections_total", "counter", "Accepted connections.", snapshot.connections);
+    append_metric(out, "http_server_active_connections", "gauge", "Open connections.", snapshot.active_connections);
+    append_metric(out, "http_server_requests_total", "counter", "Responses written.", snapshot.requests);
+    append_metric(out, "http_server_received_bytes_total", "counter", "Bytes read from clients.", snapshot.bytes_in);
+    append_metric(out, "http_server_sent_bytes_total", "counter", "Response bytes written.", snapshot.bytes_out);
+
+    out += "# HELP http_server_responses_total Responses by status code, 0 if unknown.\n";
+    out += "# TYPE http_server_responses_total counter\n";
+    for (int i = 0; i < MAX_STATUS; ++i) {
+        if (snapshot.status[i] > 0) {
+            out += "http_server_responses_total{code=\"" + to_string(i) + "\"} " + to_string(snapshot.status[i]) + "\n";
+        }
+    }
+
+    out += "# HELP http_server_stage_seconds Request latency by stage.\n";
+    out += "# TYPE http_server_stage_seconds histogram\n";
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        const HistogramSnapshot& stage = snapshot.stages[i];
+        string label = string("stage=\"") + STAGE_NAMES[i] + "\"";
+        for (uint64_t bound : EXPORT_BUCKETS_US) {
+            out += "http_server_stage_seconds_bucket{" + label + ",le=\"" + seconds(bound) + "\"} "
+                   + to_string(stage.count_le(bound)) + "\n";
+        }
+        out += "http_server_stage_seconds_bucket{" + label + ",le=\"+Inf\"} " + to_string(stage.count) + "\n";
+        out += "http_server_stage_seconds_sum{" + label + "} " + seconds(stage.sum) + "\n";
+        out += "http_server_stage_seconds_count{" + label + "} " + to_string(stage.count) + "\n";
+    }
+
+    out += "# HELP http_server_stage_quantile_seconds Request latency quantiles by stage, relative error 1/16.\n";
+    out += "# TYPE http_server_stage_quantile_seconds gauge\n";
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        const HistogramSnapshot& stage = snapshot.stages[i];
+        for (double q : EXPORT_QUANTILES) {
+            char quantile[16];
+            snprintf(quantile, sizeof(quantile), "%g", q);
+            out += string("http_server_stage_quantile_seconds{stage=\"") + STAGE_NAMES[i] + "\",quantile=\""
+                   + quantile + "\"} " + seconds(stage.quantile(q)) + "\n";
+        }
+    }
+}
+
+}}
@@ -0,0 +1,119 @@
+#ifndef __HTTP_SERVER_METRICS_H__
+#define __HTTP_SERVER_METRICS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace http {
+namespace metrics {
+
+// 一个请求依次经过的阶段
+enum class Stage {
+    // accept 到读到第一个字节
+    AcceptToFirstByte = 0,
+    // 第一个字节到请求（含请求体）读取、解析完成
+    Parse,
+    // 解析完成到业务端调用 response
+    Handler,
+    // 调用 response 到写完，包括压缩和组装响应
+    Write
+};
+
+static const size_t STAGE_COUNT = 4;
+
+/*
+ * HDR 风格的延迟直方图（微秒）
+ * 小于 32 的值每个值一个桶，之后每个 2 的幂区间分 16 个桶，相对误差不超过 1/16
+ * 只由一个线程写，其它线程可以同时读
+ */
+class LatencyHistogram {
+public:
+    // 超过的值记在最后一个桶，约 19 小时
+    static const uint64_t MAX_VALUE = (1ULL << 36) - 1;
+    static const size_t BUCKET_COUNT = 32 + (36 - 5) * 16;
+
+    static size_t bucket_index(uint64_t value);
+    // 桶内的最大值
+    static uint64_t bucket_upper(size_t index);
+
+    LatencyHistogram();
+
+    void record(uint64_t value);
+
+    // 累加到 buckets，返回记录数，sum 累加总和
+    uint64_t merge_into(std::vector<uint64_t>& buckets, uint64_t& sum) const;
+
+private:
+    std::atomic<uint64_t> _buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sum;
+};
+
+// 合并所有线程后的直方图
+struct HistogramSnapshot {
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(LatencyHistogram::BUCKET_COUNT, 0);
+    uint64_t count = 0;
+    uint64_t sum = 0;
+
+    // 小于等于 value 的记录数，只计入上界不超过 value 的桶，value 所在桶中的记录可能少算
+    uint64_t count_le(uint64_t value) const;
+    // q 分位数所在桶的最大值
+    uint64_t quantile(double q) const;
+};
+
+struct MetricsSnapshot {
+    uint64_t connections = 0;
+    uint64_t active_connections = 0;
+    uint64_t requests = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    // 状态码 -> 响应数，0 表示无法识别的状态码
+    std::vector<uint64_t> status;
+    HistogramSnapshot stages[STAGE_COUNT];
+};
+
+/*
+ * 服务端的计数器和延迟直方图
+ *
+ * 每个线程第一次记录时分配自己的一份，之后只写自己的，不加锁、不争用缓存行；
+ * 读取时合并所有线程，线程退出后它的数据仍然保留
+ */
+class ServerMetrics {
+public:
+    static const int MAX_STATUS = 600;
+
+    ServerMetrics();
+    ~ServerMetrics();
+
+    void connection_opened();
+    void connection_closed();
+    void add_bytes_in(uint64_t bytes);
+    void record_stage(Stage stage, uint64_t latency_us);
+    void record_response(int status, uint64_t bytes_out);
+
+    MetricsSnapshot Snapshot() const;
+
+    // Prometheus 文本格式 0.0.4
+    void write_prometheus(std::string& out) const;
+
+private:
+    struct ThreadMetrics;
+
+    ServerMetrics(const ServerMetrics&);
+    ServerMetrics& operator=(const ServerMetrics&);
+
+    ThreadMetrics& local();
+
+    // 区分实例，不复用地址
+    const uint64_t _id;
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<ThreadMetrics>> _threads;
+};
+
+}}
+
+#endif
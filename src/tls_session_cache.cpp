@@ -0,0 +1,117 @@
+#include "tls_session_cache.h"
+
+using namespace std;
+
+namespace http {
+namespace httpclient {
+
+// boost::asio 已经占用了 SSL / SSL_CTX 的 app_data，使用单独的 ex_data
+static int ctx_index() {
+    static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+static int ssl_index() {
+    static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+TlsSessionCache::TlsSessionCache(size_t max_entries)
+    : _max_entries(max_entries) {
+}
+
+TlsSessionCache::~TlsSessionCache() {
+    clear();
+}
+
+void TlsSessionCache::attach(boost::asio::ssl::context& ctx) {
+    SSL_CTX* handle = ctx.native_handle();
+    SSL_CTX_set_ex_data(handle, ctx_index(), this);
+    // 会话由 TlsSessionCache 保存，不使用 OpenSSL 的内部缓存
+    SSL_CTX_set_session_cache_mode(handle, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(handle, &TlsSessionCache::new_session);
+}
+
+int TlsSessionCache::new_session(SSL* ssl, SSL_SESSION* session) {
+    TlsSessionCache* cache = static_cast<TlsSessionCache*>(
+        SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ctx_index()));
+    const string* key = static_cast<const string*>(SSL_get_ex_data(ssl, ssl_index()));
+    if (cache == nullptr || key == nullptr) {
+        return 0;
+    }
+    // 连接没有 SSL_shutdown 就关闭时 OpenSSL 会把它的会话标记为不可复用，缓存中保存副本
+    SSL_SESSION* copy = SSL_SESSION_dup(session);
+    if (copy != nullptr) {
+        cache->store(*key, copy);
+    }
+    return 0;
+}
+
+void TlsSessionCache::store(const string& key, SSL_SESSION* session) {
+    lock_guard<mutex> lock(_mutex);
+    auto it = _sessions.find(key);
+    if (it != _sessions.end()) {
+        SSL_SESSION_free(it->second);
+        it->second = session;
+        return;
+    }
+
+    if (_sessions.size() >= _max_entries && !_sessions.empty()) {
+        SSL_SESSION_free(_sessions.begin()->second);
+        _sessions.erase(_sessions.begin());
+    }
+    _sessions[key] = session;
+}
+
+void TlsSessionCache::prepare(SSL* ssl, const string* key) {
+    SSL_set_ex_data(ssl, ssl_index(), const_cast<string*>(key));
+
+    SSL_SESSION* copy = nullptr;
+    {
+        lock_guard<mutex> lock(_mutex);
+        auto it = _sessions.find(*key);
+        if (it != _sessions.end()) {
+            copy = SSL_SESSION_dup(it->second);
+        }
+    }
+    // 同样使用副本，避免连接异常关闭影响缓存中的会话
+    if (copy != nullptr) {
+        SSL_set_session(ssl, copy);
+        SSL_SESSION_free(copy);
+    }
+}
+
+void TlsSessionCache::handshake_done(SSL* ssl, const string& key, bool success) {
+    lock_guard<mutex> lock(_mutex);
+    if (!success) {
+        ++_stats.failed_handshakes;
+        // 会话可能已经失效，下次重新完整握手
+        auto it = _sessions.find(key);
+        if (it != _sessions.end()) {
+            SSL_SESSION_free(it->second);
+            _sessions.erase(it);
+        }
+        return;
+    }
+
+    if (SSL_session_reused(ssl)) {
+        ++_stats.resumed_handshakes;
+    } else {
+        ++_stats.full_handshakes;
+    }
+}
+
+void TlsSessionCache::clear() {
+    lock_guard<mutex> lock(_mutex);
+    for (auto& session : _sessions) {
+        SSL_SESSION_free(session.second);
+    }
+    _sessions.clear();
+}
+
+TlsStats TlsSessionCache::Stats() const {
+    lock_guard<mutex> lock(_mutex);
+    return _stats;
+}
+
+}}
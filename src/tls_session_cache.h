@@ -0,0 +1,66 @@
+#ifndef __HTTP_TLS_SESSION_CACHE_H__
+#define __HTTP_TLS_SESSION_CACHE_H__
+
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include <boost/asio/ssl.hpp>
+
+namespace http {
+namespace httpclient {
+
+struct TlsStats {
+    uint64_t full_handshakes = 0;
+    // 复用会话的简化握手
+    uint64_t resumed_handshakes = 0;
+    uint64_t failed_handshakes = 0;
+};
+
+/*
+ * 客户端 TLS 会话缓存，线程安全
+ *
+ * 按 host:port 保存服务端下发的会话（session id 或 session ticket），
+ * 新建连接时带上会话，服务端接受时只需要简化握手
+ */
+class TlsSessionCache {
+public:
+    explicit TlsSessionCache(size_t max_entries = 1024);
+    ~TlsSessionCache();
+
+    /*
+     * 在 ssl::context 上注册新会话回调，context 只能关联一个 TlsSessionCache
+     */
+    void attach(boost::asio::ssl::context& ctx);
+
+    /*
+     * 握手前调用：关联 key，有缓存的会话时设置到 ssl 上
+     * key 需要在 ssl 的生命周期内有效
+     */
+    void prepare(SSL* ssl, const std::string* key);
+
+    /*
+     * 握手结束后调用，统计是否复用了会话；握手失败时丢弃该 key 的会话
+     */
+    void handshake_done(SSL* ssl, const std::string& key, bool success);
+
+    void clear();
+    TlsStats Stats() const;
+
+private:
+    TlsSessionCache(const TlsSessionCache&);
+    TlsSessionCache& operator=(const TlsSessionCache&);
+
+    // SSL_CTX_sess_set_new_cb 回调
+    static int new_session(SSL* ssl, SSL_SESSION* session);
+    void store(const std::string& key, SSL_SESSION* session);
+
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, SSL_SESSION*> _sessions;
+    size_t _max_entries;
+    TlsStats _stats;
+};
+
+}}
+
+#endif
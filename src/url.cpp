@@ -0,0 +1,167 @@
+#include "url.h"
+
+#include <vector>
+#include <boost/algorithm/string/predicate.hpp>
+#include "utils.h"
+
+using http::utils::hex_value;
+
+namespace http {
+namespace url {
+
+Url::Url() : _valid(false), _params_parsed(false) {
+}
+
+bool Url::parse(const string& target) {
+    _raw = target;
+    _params_parsed = false;
+    _params.clear();
+
+    size_t begin = 0;
+    // 去掉协议头、host
+    if (boost::algorithm::istarts_with(target, "http://")) {
+        begin = 7;
+    } else if (boost::algorithm::istarts_with(target, "https://")) {
+        begin = 8;
+    }
+    if (begin > 0) {
+        begin = target.find_first_of("/?#", begin);
+        if (begin == string::npos) {
+            begin = target.size();
+        }
+    }
+
+    size_t end = target.find('#', begin);
+    if (end == string::npos) {
+        end = target.size();
+    }
+
+    size_t qpos = target.find('?', begin);
+    if (qpos != string::npos && qpos < end) {
+        _raw_path = target.substr(begin, qpos - begin);
+        _query = target.substr(qpos + 1, end - qpos - 1);
+    } else {
+        _raw_path = target.substr(begin, end - begin);
+        _query.clear();
+    }
+
+    if (_raw_path.empty()) {
+        _raw_path = "/";
+    }
+
+    // OPTIONS * HTTP/1.1
+    if (_raw_path == "*") {
+        _path = _raw_path;
+        _valid = true;
+        return _valid;
+    }
+
+    _valid = normalize_path(_raw_path, _path);
+    if (!_valid) {
+        _path.clear();
+    }
+    return _valid;
+}
+
+bool Url::normalize_path(const string& raw, string& path) {
+    if (raw.empty() || raw[0] != '/') {
+        return false;
+    }
+
+    // 解码
+    string decoded;
+    decoded.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+        char c = raw[i];
+        if (c != '%') {
+            decoded += c;
+            continue;
+        }
+        int hi, lo;
+        if (i + 2 >= raw.size() || (hi = hex_value(raw[i+1])) < 0 || (lo = hex_value(raw[i+2])) < 0) {
+            return false;
+        }
+        char d = char(hi * 16 + lo);
+        if (d == '\0') {
+            return false;
+        } else if (d == '/') {
+            decoded += "%2F";
+        } else if (d == '%') {
+            decoded += "%25";
+        } else {
+            decoded += d;
+        }
+        i += 2;
+    }
+
+    // 按 / 切分，处理 . 和 ..
+    std::vector<std::pair<size_t, size_t>> segments;
+    bool trailing_slash = false;
+    size_t cur = 1;
+    while (cur <= decoded.size()) {
+        size_t next = decoded.find('/', cur);
+        if (next == string::npos) {
+            next = decoded.size();
+        }
+        size_t len = next - cur;
+        bool last = next == decoded.size();
+
+        if (len == 0 || (len == 1 && decoded[cur] == '.')) {
+            trailing_slash = last;
+        } else if (len == 2 && decoded[cur] == '.' && decoded[cur+1] == '.') {
+            if (!segments.empty()) {
+                segments.pop_back();
+            }
+            trailing_slash = last;
+        } else {
+            segments.push_back(std::make_pair(cur, len));
+            trailing_slash = false;
+        }
+        cur = next + 1;
+    }
+
+    path.clear();
+    path.reserve(decoded.size());
+    for (const auto& seg : segments) {
+        path += '/';
+        path.append(decoded, seg.first, seg.second);
+    }
+    if (path.empty() || trailing_slash) {
+        path += '/';
+    }
+    return true;
+}
+
+bool Url::Valid() const {
+    return _valid;
+}
+
+const string& Url::Raw() const {
+    return _raw;
+}
+
+const string& Url::RawPath() const {
+    return _raw_path;
+}
+
+const string& Url::Path() const {
+    return _path;
+}
+
+const string& Url::Query() const {
+    return _query;
+}
+
+const FormParams& Url::Params() const {
+    if (!_params_parsed) {
+        FormParams::parse(_query, _params);
+        _params_parsed = true;
+    }
+    return _params;
+}
+
+const string* Url::Param(const string& key) const {
+    return Params().get(key);
+}
+
+}}
@@ -0,0 +1,67 @@
+#ifndef __HTTP_URL_H__
+#define __HTTP_URL_H__
+
+#include "form_params.h"
+
+#include <string>
+
+using std::string;
+using http::form::FormParams;
+
+namespace http {
+namespace url {
+
+/*
+ * 请求行中的 request-target
+ * path 在解析时规范化，query 参数在第一次访问时才解析
+ */
+class Url {
+public:
+    Url();
+
+    /*
+     * 功能 : 解析 request-target
+     * target : /path?query 或 http://host/path?query
+     * ret  : path 是否合法
+     */
+    bool parse(const string& target);
+
+    /*
+     * 功能 : path 解码并规范化，用于路由
+     * 解码 %XX（%2F 保持编码，避免改变路径层级），合并 //，处理 . 和 ..，不会超出根目录
+     * raw  : 原始 path，必须以 / 开头
+     * path : 规范化结果
+     * ret  : 是否合法，包含 %00 等非法字符时返回 false
+     */
+    static bool normalize_path(const string& raw, string& path);
+
+    bool Valid() const;
+    const string& Raw() const;
+    const string& RawPath() const;
+    const string& Path() const;
+    const string& Query() const;
+
+    /*
+     * query 参数，已 urldecode
+     */
+    const FormParams& Params() const;
+
+    /*
+     * 返回 query 参数 key 的第一个值，不存在返回 nullptr
+     */
+    const string* Param(const string& key) const;
+
+private:
+    string _raw;
+    string _raw_path;
+    string _path;
+    string _query;
+    bool _valid;
+
+    mutable bool _params_parsed;
+    mutable FormParams _params;
+};
+
+}}
+
+#endif
@@ -5,6 +5,11 @@
 
 #include "utils.h"
 
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 using namespace boost::iostreams;
 
@@ -42,26 +47,96 @@ void gzip_decompress(const string& text, string& out_text) {
     fos << std::flush;
 }
 
-void urldecode(const string& encd, string& decd) {
-    int j;
-    char p[2];
-    unsigned int num;
-    j=0;
-
-    for(int i = 0; i < encd.size(); i++) {
-        memset(p, '\0', 2);
-        if(encd[i] != '%') {
-            decd += encd[i];
-            continue;
+GzipDecompressor::GzipDecompressor(const Sink& sink) : _sink(sink), _written(false) {
+    SinkDevice device;
+    device.sink = &_sink;
+    _out.push(gzip_decompressor(), 64 * 1024);
+    _out.push(device, 64 * 1024);
+    // 解压错误、sink 抛出的异常重新抛给调用方
+    _out.exceptions(std::ios::badbit);
+}
+
+void GzipDecompressor::write(const char* data, size_t size) {
+    _written = _written || size > 0;
+    _out.write(data, size);
+}
+
+void GzipDecompressor::finish() {
+    if (_written) {
+        boost::iostreams::close(_out);
+    }
+}
+
+// 查找下一个需要解码的字符，没有则返回 size
+static size_t find_escape(const char* data, size_t size, bool plus_to_space) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 每次比较 16 字节
+    const __m128i percent = _mm_set1_epi8('%');
+    const __m128i plus = _mm_set1_epi8(plus_to_space ? '+' : '%');
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(chunk, percent), _mm_cmpeq_epi8(chunk, plus));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
         }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (data[i] == '%' || (plus_to_space && data[i] == '+')) {
+            return i;
+        }
+    }
+    return size;
+}
+
+// 解码 data[i] 处的转义，返回解码后的字符，i 移动到下一个待处理位置
+static char decode_escape(const char* data, size_t size, size_t& i) {
+    if (data[i] == '+') {
+        ++i;
+        return ' ';
+    }
+    int hi, lo;
+    if (i + 2 < size && (hi = hex_value(data[i+1])) >= 0 && (lo = hex_value(data[i+2])) >= 0) {
+        i += 3;
+        return char(hi * 16 + lo);
+    }
+    // 非法的转义原样保留
+    ++i;
+    return '%';
+}
 
-        p[0] = encd[++i];
-        p[1] = encd[++i];
+void urldecode(const string& encd, string& decd, bool plus_to_space) {
+    const char* data = encd.data();
+    size_t size = encd.size();
+    decd.reserve(decd.size() + size);
 
-        p[0] = p[0] - 48 - ((p[0] >= 'A') ? 7 : 0) - ((p[0] >= 'a') ? 32 : 0);
-        p[1] = p[1] - 48 - ((p[1] >= 'A') ? 7 : 0) - ((p[1] >= 'a') ? 32 : 0);
-        decd += (char)(p[0] * 16 + p[1]);
+    size_t i = 0;
+    while (i < size) {
+        size_t pos = i + find_escape(data + i, size - i, plus_to_space);
+        decd.append(data + i, pos - i);
+        i = pos;
+        if (i < size) {
+            decd += decode_escape(data, size, i);
+        }
+    }
+}
+
+size_t urldecode(char* data, size_t size, bool plus_to_space) {
+    size_t i = 0, j = 0;
+    while (i < size) {
+        size_t pos = i + find_escape(data + i, size - i, plus_to_space);
+        if (i != j) {
+            memmove(data + j, data + i, pos - i);
+        }
+        j += pos - i;
+        i = pos;
+        if (i < size) {
+            data[j++] = decode_escape(data, size, i);
+        }
     }
+    return j;
 }
 
 std::string get_extension_from_url(const std::string& url) {
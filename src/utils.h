@@ -9,6 +9,7 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <functional>
 #include <sys/time.h>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filtering_streambuf.hpp>
@@ -35,9 +36,67 @@ void gzip_compress(const std::string& text, std::string& out_text);
 void gzip_decompress(const std::string& text, std::string& out_text);
 
 /*
- * urldecode
+ * 流式 gzip 解压
+ * 压缩数据可以任意切分后多次 write，解压结果按顺序交给 sink，
+ * 数据错误时 write / finish 抛出异常
  */
-void urldecode(const std::string& encd, std::string& decd);
+class GzipDecompressor {
+public:
+    typedef std::function<void(const char* data, size_t size)> Sink;
+
+    explicit GzipDecompressor(const Sink& sink);
+
+    void write(const char* data, size_t size);
+
+    /*
+     * 数据写完后调用，输出剩余数据
+     */
+    void finish();
+
+private:
+    GzipDecompressor(const GzipDecompressor&);
+    GzipDecompressor& operator=(const GzipDecompressor&);
+
+    struct SinkDevice {
+        typedef char char_type;
+        typedef boost::iostreams::sink_tag category;
+
+        const Sink* sink;
+
+        std::streamsize write(const char* data, std::streamsize size) {
+            (*sink)(data, size);
+            return size;
+        }
+    };
+
+    Sink _sink;
+    boost::iostreams::filtering_ostream _out;
+    // 没有写入任何数据时 finish 不做检查，空包体按空处理
+    bool _written;
+};
+
+/*
+ * 十六进制字符的值，不是十六进制字符时返回 -1
+ * chunk-size、%XX 解析时逐字节调用，定义在头文件中以便内联
+ */
+inline int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * urldecode，结果追加到 decd
+ * plus_to_space : '+' 解码为空格（application/x-www-form-urlencoded）
+ */
+void urldecode(const std::string& encd, std::string& decd, bool plus_to_space = false);
+
+/*
+ * 原地 urldecode
+ * ret : 解码后的长度
+ */
+size_t urldecode(char* data, size_t size, bool plus_to_space = false);
 
 /*
  * 获取 url extension